@@ -0,0 +1,255 @@
+// Native benchmark of the pylibheif wrapper classes, without Python call overhead.
+//
+// Runs encode_image -> write_to_bytes -> read_from_memory -> decode for every combination of
+// resolution, chroma format, encoder and thread count and prints the timings as JSON:
+//
+//   pylibheif_benchmark --sizes 1280x720,3840x2160 --encoders x265,kvazaar,aom \
+//       --chroma 420,444 --threads 1,4 --iterations 5 --output results.json
+//
+// The wrapper exchanges Python objects (bytes, buffers), so an embedded interpreter is
+// started; every timed call runs without Python code in between.
+
+#include <pybind11/embed.h>
+#include <pybind11/stl.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "context.hpp"
+#include "encoder.hpp"
+#include "image.hpp"
+
+namespace py = pybind11;
+using namespace pylibheif;
+
+struct Options {
+    std::vector<std::pair<int, int>> sizes = {{640, 480}, {1920, 1080}, {3840, 2160}};
+    std::vector<std::string> encoders = {"x265", "kvazaar", "aom"};
+    std::vector<std::string> chroma = {"420", "444"};
+    std::vector<int> threads = {1, 4};
+    int iterations = 5;
+    int quality = 50;
+    std::string output;  // Empty: stdout
+};
+
+static std::vector<std::string> split(const std::string& list) {
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        if (end > start) {
+            items.push_back(list.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return items;
+}
+
+static Options parse_options(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Missing value for " + arg);
+        }
+        const std::string value = argv[++i];
+        if (arg == "--sizes") {
+            options.sizes.clear();
+            for (const std::string& size : split(value)) {
+                int width, height;
+                if (std::sscanf(size.c_str(), "%dx%d", &width, &height) != 2 || width <= 0 ||
+                    height <= 0) {
+                    throw std::invalid_argument("Sizes must look like 1920x1080");
+                }
+                options.sizes.emplace_back(width, height);
+            }
+        } else if (arg == "--encoders") {
+            options.encoders = split(value);
+        } else if (arg == "--chroma") {
+            options.chroma = split(value);
+        } else if (arg == "--threads") {
+            options.threads.clear();
+            for (const std::string& count : split(value)) {
+                options.threads.push_back(std::stoi(count));
+            }
+        } else if (arg == "--iterations") {
+            options.iterations = std::max(1, std::stoi(value));
+        } else if (arg == "--quality") {
+            options.quality = std::stoi(value);
+        } else if (arg == "--output") {
+            options.output = value;
+        } else {
+            throw std::invalid_argument("Unknown option " + arg);
+        }
+    }
+    return options;
+}
+
+// Deterministic gradient with noise, so the encoders see neither a flat nor a random image
+static std::shared_ptr<HeifImage> make_image(int width, int height) {
+    auto image = std::make_shared<HeifImage>(width, height, heif_colorspace_RGB,
+                                             heif_chroma_interleaved_RGB);
+    image->add_plane(heif_channel_interleaved, width, height, 8);
+    int stride;
+    uint8_t* data = heif_image_get_plane(image->get(), heif_channel_interleaved, &stride);
+    uint32_t state = 12345;
+    for (int y = 0; y < height; ++y) {
+        uint8_t* row = data + static_cast<size_t>(y) * stride;
+        for (int x = 0; x < width; ++x) {
+            state = state * 1664525u + 1013904223u;
+            const int noise = static_cast<int>(state >> 28) - 8;
+            row[3 * x + 0] = static_cast<uint8_t>(std::clamp(x * 255 / width + noise, 0, 255));
+            row[3 * x + 1] = static_cast<uint8_t>(std::clamp(y * 255 / height + noise, 0, 255));
+            row[3 * x + 2] = static_cast<uint8_t>(std::clamp((x + y) % 256 + noise, 0, 255));
+        }
+    }
+    return image;
+}
+
+static std::unique_ptr<HeifEncoder> make_encoder(const std::string& id_name) {
+    for (const HeifEncoderDescriptor& descriptor : get_encoder_descriptors()) {
+        if (descriptor.id_name() == id_name) {
+            return std::make_unique<HeifEncoder>(descriptor);
+        }
+    }
+    return nullptr;
+}
+
+static double elapsed_ms(const std::function<void()>& work) {
+    const auto start = std::chrono::steady_clock::now();
+    work();
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::milli>(elapsed).count();
+}
+
+static py::dict summarize(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    const size_t n = samples.size();
+    py::dict summary;
+    summary["min_ms"] = samples.front();
+    summary["median_ms"] = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+    summary["mean_ms"] = std::accumulate(samples.begin(), samples.end(), 0.0) / n;
+    summary["max_ms"] = samples.back();
+    return summary;
+}
+
+static py::dict run_case(const Options& options, const HeifImage& image,
+                         const std::string& encoder_name, const std::string& chroma,
+                         int threads) {
+    py::dict result;
+    result["encoder"] = encoder_name;
+    result["width"] = heif_image_get_primary_width(image.get());
+    result["height"] = heif_image_get_primary_height(image.get());
+    result["chroma"] = chroma;
+    result["threads"] = threads;
+
+    auto encoder = make_encoder(encoder_name);
+    if (!encoder) {
+        result["skipped"] = "encoder not available";
+        return result;
+    }
+    try {
+        encoder->set_lossy_quality(options.quality);
+        encoder->set_parameter("chroma", chroma);
+    } catch (const std::exception& e) {
+        // e.g. a chroma format the encoder does not offer
+        result["skipped"] = std::string(e.what());
+        return result;
+    }
+    try {
+        encoder->set_threads(threads);
+        result["encoder_threads"] = threads;
+    } catch (const std::exception&) {
+        // e.g. kvazaar: only decoding uses the thread count
+        result["encoder_threads"] = py::none();
+    }
+
+    std::map<std::string, std::vector<double>> samples;
+    size_t encoded_size = 0;
+    // The first round warms up codec tables and the allocator and is not recorded
+    for (int i = 0; i <= options.iterations; ++i) {
+        std::map<std::string, double> round;
+        HeifContext out_ctx;
+        round["encode_image"] = elapsed_ms([&] { encoder->encode_image(out_ctx, image); });
+
+        py::bytes data;
+        round["write_to_bytes"] = elapsed_ms([&] { data = out_ctx.write_to_bytes(); });
+        // Serialization alone, to separate the copy into the bytes object
+        round["write_context"] = elapsed_ms([&] {
+            std::vector<uint8_t> raw;
+            write_context_to_vector(out_ctx.get(), raw);
+            encoded_size = raw.size();
+        });
+
+        HeifContext in_ctx;
+        in_ctx.set_max_decoding_threads(threads);
+        round["read_from_memory"] = elapsed_ms([&] { in_ctx.read_from_memory(data); });
+        round["decode"] = elapsed_ms([&] {
+            in_ctx.get_primary_image_handle()->decode(heif_colorspace_RGB,
+                                                      heif_chroma_interleaved_RGB);
+        });
+
+        if (i > 0) {
+            for (const auto& stage : round) {
+                samples[stage.first].push_back(stage.second);
+            }
+        }
+    }
+
+    py::dict stages;
+    for (const auto& stage : samples) {
+        stages[py::str(stage.first)] = summarize(stage.second);
+    }
+    result["encoded_bytes"] = encoded_size;
+    result["stages"] = stages;
+    return result;
+}
+
+int main(int argc, char** argv) {
+    py::scoped_interpreter interpreter;
+    try {
+        const Options options = parse_options(argc, argv);
+        py::list results;
+        for (const auto& size : options.sizes) {
+            auto image = make_image(size.first, size.second);
+            for (const std::string& encoder : options.encoders) {
+                for (const std::string& chroma : options.chroma) {
+                    for (int threads : options.threads) {
+                        std::cerr << encoder << " " << size.first << "x" << size.second << " "
+                                  << chroma << " threads=" << threads << std::endl;
+                        results.append(run_case(options, *image, encoder, chroma, threads));
+                    }
+                }
+            }
+        }
+
+        py::dict report;
+        report["libheif_version"] = heif_get_version();
+        report["iterations"] = options.iterations;
+        report["quality"] = options.quality;
+        report["results"] = results;
+        py::object dumps = py::module_::import("json").attr("dumps");
+        const std::string json = dumps(report, py::arg("indent") = 2).cast<std::string>();
+
+        if (options.output.empty()) {
+            std::cout << json << std::endl;
+        } else {
+            py::module_::import("pathlib").attr("Path")(options.output).attr("write_text")(json);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "pylibheif_benchmark: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
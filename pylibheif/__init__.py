@@ -4,20 +4,70 @@ from ._pylibheif import (
     HeifChroma,
     HeifChannel,
     HeifCompressionFormat,
+    HeifChromaUpsampling,
+    HeifChromaDownsampling,
     HeifError,
     HeifContext,
     HeifImageHandle,
     HeifPlane,
+    HeifTensor,
     HeifImage,
     HeifEncoderDescriptor,
     get_encoder_descriptors,
     HeifEncoder,
+    HeifDecoderDescriptor,
+    get_decoder_descriptors,
+    DecodingOptions,
+    HeifColorPrimaries,
+    HeifTransferCharacteristics,
+    HeifMatrixCoefficients,
+    HeifOrientation,
+    HeifDepthRepresentationType,
+    HeifDepthRepresentation,
+    NclxColorProfile,
+    EncodingOptions,
+    HeifImageTiling,
+    decode_batch,
+    encode_batch,
+    transcode,
+    HeifProbeInfo,
+    probe,
+    probe_batch,
+    HeifFrame,
+    HeifSequence,
+    CancelToken,
+    MemoryBudget,
+    HeifSecurityLimits,
+    HeifProgressStep,
+    ImagePoolStats,
+    enable_image_pool,
+    disable_image_pool,
+    clear_image_pool,
+    get_image_pool_stats,
+    enable_stats,
+    get_stats,
+    reset_stats,
+    WorkQueue,
+    HeifMetadataBlock,
+    read_metadata_batch,
+    edit_metadata,
+    HeifTargetEncoding,
+    encode_to_target,
+    compare_images,
+    apply_gain_map,
     __doc__,
 )
 
 import asyncio
+import contextlib
+import os
+import sys
+import threading
+from multiprocessing import resource_tracker, shared_memory
 from typing import Optional, Union, List
 
+import numpy as np
+
 # Re-export all names from the C++ extension and async wrappers
 __all__ = [
     "HeifErrorCode",
@@ -25,14 +75,68 @@ __all__ = [
     "HeifChroma",
     "HeifChannel",
     "HeifCompressionFormat",
+    "HeifChromaUpsampling",
+    "HeifChromaDownsampling",
     "HeifError",
     "HeifContext",
     "HeifImageHandle",
     "HeifPlane",
+    "HeifTensor",
     "HeifImage",
     "HeifEncoderDescriptor",
     "get_encoder_descriptors",
     "HeifEncoder",
+    "HeifDecoderDescriptor",
+    "get_decoder_descriptors",
+    "DecodingOptions",
+    "HeifColorPrimaries",
+    "HeifTransferCharacteristics",
+    "HeifMatrixCoefficients",
+    "HeifOrientation",
+    "HeifDepthRepresentationType",
+    "HeifDepthRepresentation",
+    "NclxColorProfile",
+    "EncodingOptions",
+    "HeifImageTiling",
+    "decode_batch",
+    "decode_batch_async",
+    "encode_batch",
+    "encode_batch_async",
+    "transcode",
+    "transcode_async",
+    "HeifProbeInfo",
+    "probe",
+    "probe_batch",
+    "HeifFrame",
+    "HeifSequence",
+    "CancelToken",
+    "MemoryBudget",
+    "HeifSecurityLimits",
+    "HeifProgressStep",
+    "ImagePoolStats",
+    "enable_image_pool",
+    "disable_image_pool",
+    "clear_image_pool",
+    "get_image_pool_stats",
+    "enable_stats",
+    "get_stats",
+    "reset_stats",
+    "collect_stats",
+    "WorkQueue",
+    "get_work_queue",
+    "set_work_queue",
+    "HeifMetadataBlock",
+    "read_metadata_batch",
+    "read_metadata_batch_async",
+    "edit_metadata",
+    "edit_metadata_async",
+    "HeifTargetEncoding",
+    "encode_to_target",
+    "encode_to_target_async",
+    "compare_images",
+    "apply_gain_map",
+    "SharedImage",
+    "decode_shared",
     "AsyncHeifContext",
     "AsyncHeifImageHandle",
     "AsyncHeifEncoder",
@@ -40,6 +144,239 @@ __all__ = [
 ]
 
 
+_work_queue: Optional[WorkQueue] = None
+_work_queue_lock = threading.Lock()
+
+
+def get_work_queue() -> WorkQueue:
+    """Return the worker pool that runs the async API, creating it on first use."""
+    global _work_queue
+    with _work_queue_lock:
+        if _work_queue is None or _work_queue.is_shutdown:
+            _work_queue = WorkQueue()
+        return _work_queue
+
+
+def set_work_queue(queue: Optional[WorkQueue]) -> None:
+    """Run the async API on `queue`; None restores a default queue on next use.
+
+    The previous queue is not shut down. Releasing the last reference to it waits for the
+    jobs it has queued.
+    """
+    global _work_queue
+    with _work_queue_lock:
+        _work_queue = queue
+
+
+async def _run(func, *args, **kwargs):
+    """Run func(*args, **kwargs) on the work queue and await its result."""
+    loop = asyncio.get_running_loop()
+    return await get_work_queue().submit(loop, func, *args, **kwargs)
+
+
+async def _run_cancellable(func, *args, cancel=None, deadline_ms=None, **kwargs):
+    """Run func(*args, cancel=token, **kwargs) on the work queue.
+
+    Cancelling the awaiting task fires the token, so the native call stops at its next check
+    and frees the thread instead of running to completion in the background. deadline_ms
+    applies to this call only: a caller's token gets a per-call child instead of a new
+    deadline.
+    """
+    if cancel is None:
+        token = CancelToken(deadline_ms)
+    elif deadline_ms is not None:
+        token = cancel.child(deadline_ms)
+    else:
+        token = cancel
+    try:
+        return await _run(func, *args, cancel=token, **kwargs)
+    except asyncio.CancelledError:
+        (cancel if cancel is not None else token).cancel()
+        raise
+
+
+def _stats_delta(before: dict, after: dict) -> dict:
+    stages = {}
+    for name, end in after["stages"].items():
+        start = before["stages"][name]
+        stage = {key: end[key] - start[key] for key in ("calls", "errors", "total_ms", "bytes")}
+        # A maximum cannot be subtracted; it is reported if it was reached inside the block
+        stage["max_ms"] = end["max_ms"] if end["max_ms"] > start["max_ms"] else None
+        stages[name] = stage
+    plugins = {
+        name: count - before["plugins"].get(name, 0)
+        for name, count in after["plugins"].items()
+        if count != before["plugins"].get(name, 0)
+    }
+    return {"enabled": True, "stages": stages, "plugins": plugins}
+
+
+@contextlib.contextmanager
+def collect_stats():
+    """Collect the stats of the calls made inside the block.
+
+    Yields a dict that is filled with the get_stats() delta on exit. Stats are enabled for
+    the duration of the block. The registry is process-wide, so calls made concurrently by
+    other threads are included.
+    """
+    was_enabled = get_stats()["enabled"]
+    enable_stats(True)
+    before = get_stats()
+    result = {}
+    try:
+        yield result
+    finally:
+        result.update(_stats_delta(before, get_stats()))
+        if not was_enabled:
+            enable_stats(False)
+
+
+# (channels, dtype) of the decode_into array of each interleaved chroma
+_SHARED_LAYOUTS = {
+    HeifChroma.InterleavedRGB: (3, "u1"),
+    HeifChroma.InterleavedRGBA: (4, "u1"),
+    HeifChroma.InterleavedRRGGBB_BE: (3, ">u2"),
+    HeifChroma.InterleavedRRGGBBAA_BE: (4, ">u2"),
+    HeifChroma.InterleavedRRGGBB_LE: (3, "<u2"),
+    HeifChroma.InterleavedRRGGBBAA_LE: (4, "<u2"),
+}
+
+# Python 3.13 added SharedMemory(track=...); before that every instance, attached or
+# created, registers the block with its process's resource tracker, which unlinks it at exit
+_SHM_TRACK_PARAM = sys.version_info >= (3, 13)
+_SHM_TRACKER = os.name == "posix"
+
+
+def _open_shared_memory(name=None, create=False, size=0, track=True):
+    """SharedMemory that stays out of this process's resource tracker unless track is set."""
+    if _SHM_TRACK_PARAM:
+        return shared_memory.SharedMemory(name=name, create=create, size=size, track=track)
+    shm = shared_memory.SharedMemory(name=name, create=create, size=size)
+    if not track and _SHM_TRACKER:
+        resource_tracker.unregister(shm._name, "shared_memory")
+    return shm
+
+
+class SharedImage:
+    """Decoded pixels in a named multiprocessing.shared_memory block.
+
+    Pickling sends only the block name, shape and dtype, so an image decoded in a worker
+    process reaches the parent without copying its pixels; `array` is a numpy view of the
+    block in whichever process holds the object. Every process closes its own mapping and
+    exactly one of them unlinks the block when done.
+
+    Attaching never registers the block with the attaching process's resource tracker, so
+    the block outlives that process. The creating process's tracker does own it (unless
+    decode_shared was called with track=False) and unlinks it when that process exits; for
+    multiprocessing workers that is the tracker of the parent.
+    """
+
+    def __init__(
+        self,
+        shm: shared_memory.SharedMemory,
+        shape: tuple,
+        dtype,
+        bit_depth: int,
+        tracked: bool = True,
+    ):
+        self._shm = shm
+        self.shape = tuple(shape)
+        self.dtype = np.dtype(dtype)
+        self.bit_depth = bit_depth
+        self._tracked = tracked
+        self._array = None
+
+    @classmethod
+    def _attach(cls, name: str, shape: tuple, dtype: str, bit_depth: int) -> "SharedImage":
+        return cls(_open_shared_memory(name=name, track=False), shape, dtype, bit_depth, False)
+
+    def __reduce__(self):
+        return (SharedImage._attach, (self.name, self.shape, self.dtype.str, self.bit_depth))
+
+    @property
+    def name(self) -> str:
+        return self._shm.name
+
+    @property
+    def array(self) -> np.ndarray:
+        """Writable numpy view of the pixels; valid until close()."""
+        if self._array is None:
+            self._array = np.ndarray(self.shape, self.dtype, buffer=self._shm.buf)
+        return self._array
+
+    def to_image(self) -> HeifImage:
+        """Copy the pixels into a HeifImage (e.g. for encoding)."""
+        array = self.array
+        if array.dtype.itemsize == 2 and not array.dtype.isnative:
+            array = array.astype(array.dtype.newbyteorder("="))
+        return HeifImage.from_array(array, bit_depth=self.bit_depth)
+
+    def close(self) -> None:
+        """Unmap the block in this process. Views obtained from `array` must be gone."""
+        self._array = None
+        self._shm.close()
+
+    def unlink(self) -> None:
+        """Free the block system-wide once every process has closed it."""
+        if not self._tracked and not _SHM_TRACK_PARAM and _SHM_TRACKER:
+            # unlink() unregisters the block before 3.13; keep the tracker's books balanced
+            resource_tracker.register(self._shm._name, "shared_memory")
+        self._shm.unlink()
+
+    def __enter__(self) -> "SharedImage":
+        return self
+
+    def __exit__(self, *exc) -> None:
+        self.close()
+
+    def __repr__(self) -> str:
+        return f"SharedImage(name={self.name!r}, shape={self.shape}, dtype={self.dtype.str!r})"
+
+
+def decode_shared(
+    handle: HeifImageHandle,
+    colorspace: HeifColorspace = HeifColorspace.RGB,
+    chroma: HeifChroma = HeifChroma.InterleavedRGB,
+    options: Optional[DecodingOptions] = None,
+    cancel: Optional[CancelToken] = None,
+    budget: Optional[MemoryBudget] = None,
+    name: Optional[str] = None,
+    track: bool = True,
+) -> SharedImage:
+    """Decode into a new shared memory block (named `name`, or a generated name).
+
+    The block is sized from the handle and filled by decode_into, so the pixels are written
+    once. Interleaved chromas give (height, width, channels) arrays; Monochrome gives
+    (height, width), with uint16 samples above 8 bits.
+
+    With track=True this process's resource tracker unlinks the block when the process
+    exits. Pass track=False when the creator may exit before the consumer is done (e.g. Ray
+    workers); the consumer must then unlink it.
+    """
+    if chroma == HeifChroma.Monochrome:
+        bit_depth = handle.luma_bits_per_pixel
+        shape = (handle.height, handle.width)
+        dtype = np.dtype("=u2" if bit_depth > 8 else "u1")
+    elif chroma in _SHARED_LAYOUTS:
+        channels, code = _SHARED_LAYOUTS[chroma]
+        bit_depth = handle.luma_bits_per_pixel if code != "u1" else 8
+        shape = (handle.height, handle.width, channels)
+        dtype = np.dtype(code)
+    else:
+        raise ValueError("decode_shared needs an interleaved or monochrome chroma")
+
+    size = max(int(np.prod(shape)) * dtype.itemsize, 1)
+    shm = _open_shared_memory(name=name, create=True, size=size, track=track)
+    image = SharedImage(shm, shape, dtype, bit_depth, track)
+    try:
+        handle.decode_into(image.array, colorspace, chroma, options, cancel, budget)
+    except BaseException:
+        image.close()
+        image.unlink()
+        raise
+    return image
+
+
 class AsyncHeifImageHandle:
     """Async wrapper for HeifImageHandle."""
 
@@ -62,9 +399,143 @@ class AsyncHeifImageHandle:
         self,
         colorspace: HeifColorspace = HeifColorspace.RGB,
         chroma: HeifChroma = HeifChroma.InterleavedRGB,
+        options: Optional[DecodingOptions] = None,
+        max_width: int = 0,
+        max_height: int = 0,
+        cancel: Optional[CancelToken] = None,
+        deadline_ms: Optional[float] = None,
+        budget: Optional[MemoryBudget] = None,
     ) -> HeifImage:
-        """Asynchronously decode the image."""
-        return await asyncio.to_thread(self._handle.decode, colorspace, chroma)
+        """Asynchronously decode the image.
+
+        With a budget, the job waits on its worker until the estimated decode memory fits.
+        """
+        return await _run_cancellable(
+            self._handle.decode,
+            colorspace,
+            chroma,
+            options,
+            max_width,
+            max_height,
+            cancel=cancel,
+            deadline_ms=deadline_ms,
+            budget=budget,
+        )
+
+    async def decode_into(
+        self,
+        out,
+        colorspace: HeifColorspace = HeifColorspace.RGB,
+        chroma: HeifChroma = HeifChroma.InterleavedRGB,
+        options: Optional[DecodingOptions] = None,
+        cancel: Optional[CancelToken] = None,
+        deadline_ms: Optional[float] = None,
+        budget: Optional[MemoryBudget] = None,
+    ) -> None:
+        """Asynchronously decode into a caller-provided buffer."""
+        await _run_cancellable(
+            self._handle.decode_into,
+            out,
+            colorspace,
+            chroma,
+            options,
+            cancel=cancel,
+            deadline_ms=deadline_ms,
+            budget=budget,
+        )
+
+    def get_tiling(self, process_transformations: bool = True) -> HeifImageTiling:
+        return self._handle.get_tiling(process_transformations)
+
+    async def decode_tile(
+        self,
+        tile_x: int,
+        tile_y: int,
+        colorspace: HeifColorspace = HeifColorspace.RGB,
+        chroma: HeifChroma = HeifChroma.InterleavedRGB,
+        options: Optional[DecodingOptions] = None,
+        cancel: Optional[CancelToken] = None,
+        deadline_ms: Optional[float] = None,
+    ) -> HeifImage:
+        """Asynchronously decode a single tile."""
+        return await _run_cancellable(
+            self._handle.decode_tile,
+            tile_x,
+            tile_y,
+            colorspace,
+            chroma,
+            options,
+            cancel=cancel,
+            deadline_ms=deadline_ms,
+        )
+
+    async def decode_region(
+        self,
+        x: int,
+        y: int,
+        width: int,
+        height: int,
+        colorspace: HeifColorspace = HeifColorspace.RGB,
+        chroma: HeifChroma = HeifChroma.InterleavedRGB,
+        options: Optional[DecodingOptions] = None,
+        cancel: Optional[CancelToken] = None,
+        deadline_ms: Optional[float] = None,
+    ) -> HeifImage:
+        """Asynchronously decode a rectangular region."""
+        return await _run_cancellable(
+            self._handle.decode_region,
+            x,
+            y,
+            width,
+            height,
+            colorspace,
+            chroma,
+            options,
+            cancel=cancel,
+            deadline_ms=deadline_ms,
+        )
+
+    @property
+    def num_thumbnails(self) -> int:
+        return self._handle.num_thumbnails
+
+    def get_thumbnail_ids(self) -> List[int]:
+        return self._handle.get_thumbnail_ids()
+
+    def get_thumbnail(self, id: int) -> "AsyncHeifImageHandle":
+        return AsyncHeifImageHandle(self._handle.get_thumbnail(id))
+
+    def get_thumbnail_for_size(
+        self, min_width: int, min_height: int
+    ) -> "AsyncHeifImageHandle":
+        return AsyncHeifImageHandle(
+            self._handle.get_thumbnail_for_size(min_width, min_height)
+        )
+
+    def get_depth_image_ids(self) -> List[int]:
+        return self._handle.get_depth_image_ids()
+
+    def get_depth_image(self, id: int) -> "AsyncHeifImageHandle":
+        return AsyncHeifImageHandle(self._handle.get_depth_image(id))
+
+    def get_depth_representation(self, id: int) -> Optional[HeifDepthRepresentation]:
+        return self._handle.get_depth_representation(id)
+
+    def get_auxiliary_image_ids(
+        self, include_alpha: bool = False, include_depth: bool = False
+    ) -> List[int]:
+        return self._handle.get_auxiliary_image_ids(include_alpha, include_depth)
+
+    def get_auxiliary_image(self, id: int) -> "AsyncHeifImageHandle":
+        return AsyncHeifImageHandle(self._handle.get_auxiliary_image(id))
+
+    @property
+    def auxiliary_type(self) -> str:
+        return self._handle.auxiliary_type
+
+    def get_gain_map(self) -> Optional["AsyncHeifImageHandle"]:
+        gain_map = self._handle.get_gain_map()
+        return AsyncHeifImageHandle(gain_map) if gain_map is not None else None
 
     def get_metadata_block_ids(self, type_filter: str = "") -> List[str]:
         return self._handle.get_metadata_block_ids(type_filter)
@@ -96,19 +567,59 @@ class AsyncHeifContext:
 
     async def read_from_file(self, filename: str) -> None:
         """Asynchronously read from file."""
-        await asyncio.to_thread(self._ctx.read_from_file, filename)
+        await _run(self._ctx.read_from_file, filename)
+
+    async def read_from_memory(self, data: Union[bytes, bytearray, memoryview]) -> None:
+        """Asynchronously read from any buffer-protocol object (not copied)."""
+        await _run(self._ctx.read_from_memory, data)
 
-    async def read_from_memory(self, data: bytes) -> None:
-        """Asynchronously read from memory."""
-        await asyncio.to_thread(self._ctx.read_from_memory, data)
+    async def read_from_mmap(self, filename: str) -> None:
+        """Asynchronously open a file through a memory map."""
+        await _run(self._ctx.read_from_mmap, filename)
+
+    async def read_from_stream(self, fileobj) -> None:
+        """Asynchronously open a seekable binary file object."""
+        await _run(self._ctx.read_from_stream, fileobj)
 
     async def write_to_file(self, filename: str) -> None:
         """Asynchronously write to file."""
-        await asyncio.to_thread(self._ctx.write_to_file, filename)
+        await _run(self._ctx.write_to_file, filename)
 
     async def write_to_bytes(self) -> bytes:
         """Asynchronously write to bytes."""
-        return await asyncio.to_thread(self._ctx.write_to_bytes)
+        return await _run(self._ctx.write_to_bytes)
+
+    async def write_to(self, fileobj) -> int:
+        """Asynchronously stream the encoded file to a writable file-like object."""
+        return await _run(self._ctx.write_to, fileobj)
+
+    async def write_into(self, buffer: Union[bytearray, memoryview]) -> int:
+        """Asynchronously write the encoded file into a preallocated buffer."""
+        return await _run(self._ctx.write_into, buffer)
+
+    async def decode_all(
+        self,
+        ids: Optional[List[int]] = None,
+        colorspace: HeifColorspace = HeifColorspace.RGB,
+        chroma: HeifChroma = HeifChroma.InterleavedRGB,
+        threads: int = 0,
+        options: Optional[DecodingOptions] = None,
+        cancel: Optional[CancelToken] = None,
+        deadline_ms: Optional[float] = None,
+        budget: Optional[MemoryBudget] = None,
+    ) -> List[HeifImage]:
+        """Asynchronously decode several images in parallel."""
+        return await _run_cancellable(
+            self._ctx.decode_all,
+            ids,
+            colorspace,
+            chroma,
+            threads,
+            options,
+            cancel=cancel,
+            deadline_ms=deadline_ms,
+            budget=budget,
+        )
 
     def get_primary_image_handle(self) -> AsyncHeifImageHandle:
         """Get async wrapper for primary image handle."""
@@ -161,10 +672,21 @@ class AsyncHeifEncoder:
         context: Union[HeifContext, AsyncHeifContext],
         image: HeifImage,
         preset: str = "",
+        options: Optional[EncodingOptions] = None,
+        cancel: Optional[CancelToken] = None,
+        deadline_ms: Optional[float] = None,
     ) -> HeifImageHandle:
         """Asynchronously encode image."""
         ctx = context._ctx if isinstance(context, AsyncHeifContext) else context
-        return await asyncio.to_thread(self._encoder.encode_image, ctx, image, preset)
+        return await _run_cancellable(
+            self._encoder.encode_image,
+            ctx,
+            image,
+            preset,
+            options,
+            cancel=cancel,
+            deadline_ms=deadline_ms,
+        )
 
     def set_lossy_quality(self, quality: int) -> None:
         self._encoder.set_lossy_quality(quality)
@@ -172,6 +694,150 @@ class AsyncHeifEncoder:
     def set_parameter(self, name: str, value: str) -> None:
         self._encoder.set_parameter(name, value)
 
+    @property
+    def threads(self) -> int:
+        return self._encoder.threads
+
+    @threads.setter
+    def threads(self, count: int) -> None:
+        self._encoder.threads = count
+
     @property
     def name(self) -> str:
         return self._encoder.name
+
+
+async def decode_batch_async(
+    inputs,
+    colorspace: HeifColorspace = HeifColorspace.RGB,
+    chroma: HeifChroma = HeifChroma.InterleavedRGB,
+    threads: int = 0,
+    options: Optional[DecodingOptions] = None,
+    max_decoding_threads: int = -1,
+    out=None,
+    cancel: Optional[CancelToken] = None,
+    deadline_ms: Optional[float] = None,
+    budget: Optional[MemoryBudget] = None,
+    security_limits: Optional[HeifSecurityLimits] = None,
+):
+    """Asynchronously decode a batch of images on the native worker pool."""
+    return await _run_cancellable(
+        decode_batch,
+        inputs,
+        colorspace,
+        chroma,
+        threads,
+        options,
+        max_decoding_threads,
+        out,
+        cancel=cancel,
+        deadline_ms=deadline_ms,
+        budget=budget,
+        security_limits=security_limits,
+    )
+
+
+async def encode_batch_async(
+    images: List[HeifImage],
+    format: HeifCompressionFormat = HeifCompressionFormat.HEVC,
+    quality: int = -1,
+    params: Optional[dict] = None,
+    threads: int = 0,
+    preset: str = "",
+    options: Optional[EncodingOptions] = None,
+    paths=None,
+    cancel: Optional[CancelToken] = None,
+    deadline_ms: Optional[float] = None,
+):
+    """Asynchronously encode a batch of images on the native worker pool."""
+    return await _run_cancellable(
+        encode_batch,
+        images,
+        format,
+        quality,
+        params or {},
+        threads,
+        preset,
+        options,
+        paths,
+        cancel=cancel,
+        deadline_ms=deadline_ms,
+    )
+
+
+async def transcode_async(
+    input,
+    output_format: HeifCompressionFormat = HeifCompressionFormat.AV1,
+    max_size: int = 0,
+    quality: int = -1,
+    params: Optional[dict] = None,
+    copy_metadata: bool = True,
+    options: Optional[DecodingOptions] = None,
+    cancel: Optional[CancelToken] = None,
+    deadline_ms: Optional[float] = None,
+) -> bytes:
+    """Asynchronously transcode an image in native code."""
+    return await _run_cancellable(
+        transcode,
+        input,
+        output_format,
+        max_size,
+        quality,
+        params or {},
+        copy_metadata,
+        options,
+        cancel=cancel,
+        deadline_ms=deadline_ms,
+    )
+
+
+async def read_metadata_batch_async(
+    inputs, threads: int = 0, type_filter: str = "", raise_errors: bool = True
+):
+    """Asynchronously read the metadata blocks of many files on the native worker pool."""
+    return await _run(read_metadata_batch, inputs, threads, type_filter, raise_errors)
+
+
+async def edit_metadata_async(
+    input,
+    output=None,
+    exif: Optional[bytes] = None,
+    xmp: Optional[bytes] = None,
+    remove: Optional[List[str]] = None,
+    padding: int = 0,
+    in_place: bool = False,
+):
+    """Asynchronously rewrite the Exif/XMP of a file without touching its image data."""
+    return await _run(
+        edit_metadata, input, output, exif, xmp, remove or [], padding, in_place
+    )
+
+
+async def encode_to_target_async(
+    image: HeifImage,
+    format: HeifCompressionFormat = HeifCompressionFormat.HEVC,
+    metric: str = "ssim",
+    target: float = 0.98,
+    min_quality: int = 0,
+    max_quality: int = 100,
+    max_attempts: int = 8,
+    params: Optional[dict] = None,
+    options: Optional[EncodingOptions] = None,
+    cancel: Optional[CancelToken] = None,
+    deadline_ms: Optional[float] = None,
+):
+    """Asynchronously encode an image at the lowest quality reaching a metric target."""
+    return await _run_cancellable(
+        encode_to_target,
+        image,
+        format,
+        metric,
+        target,
+        min_quality,
+        max_quality,
+        max_attempts,
+        params or {},
+        options,
+        cancel=cancel,
+        deadline_ms=deadline_ms,
+    )
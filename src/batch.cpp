@@ -0,0 +1,249 @@
+#include "batch.hpp"
+
+#include <exception>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "budget.hpp"
+#include "context.hpp"
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "image.hpp"
+#include "reader.hpp"
+#include "thread_pool.hpp"
+
+namespace pylibheif {
+
+BatchInput resolve_input(const py::handle& item, const char* caller) {
+    BatchInput input;
+    if (py::isinstance<py::str>(item) ||
+        py::isinstance(item, py::module_::import("os").attr("PathLike"))) {
+        input.path = py::module_::import("os").attr("fspath")(item).cast<std::string>();
+        return input;
+    }
+    if (!PyObject_CheckBuffer(item.ptr())) {
+        throw py::type_error(std::string(caller) + " inputs must be paths or buffer objects");
+    }
+    // libheif reads the view in place, so it has to be one flat byte range
+    auto info =
+        std::make_unique<py::buffer_info>(py::reinterpret_borrow<py::buffer>(item).request());
+    if (info->ndim > 1 || (info->ndim == 1 && info->strides[0] != info->itemsize)) {
+        throw std::invalid_argument(std::string(caller) + " buffers must be C-contiguous 1-D");
+    }
+    input.size = static_cast<size_t>(info->size * info->itemsize);
+    input.buffer = std::move(info);
+    return input;
+}
+
+// Resolves every input under the GIL so the workers never touch Python objects
+static std::vector<BatchInput> collect_inputs(const py::sequence& inputs) {
+    std::vector<BatchInput> result;
+    result.reserve(inputs.size());
+    for (auto item : inputs) {
+        result.push_back(resolve_input(item, "decode_batch"));
+    }
+    return result;
+}
+
+HandlePtr open_primary(const BatchInput& input, int max_decoding_threads,
+                       const SecurityLimits* limits) {
+    ContextPtr ctx(heif_context_alloc());
+    if (max_decoding_threads >= 0) {
+        heif_context_set_max_decoding_threads(ctx.get(), max_decoding_threads);
+    }
+    if (limits) {
+        limits->apply_to(ctx.get());
+    }
+    if (input.buffer) {
+        check_error(heif_context_read_from_memory_without_copy(ctx.get(), input.buffer->ptr,
+                                                               input.size, nullptr));
+    } else {
+        check_error(heif_context_read_from_file(ctx.get(), input.path.c_str(), nullptr));
+    }
+
+    heif_image_handle* handle;
+    check_error(heif_context_get_primary_image_handle(ctx.get(), &handle));
+    return HandlePtr(handle);
+}
+
+std::unique_ptr<ByteSource> open_source(const BatchInput& input) {
+    if (input.buffer) {
+        return std::make_unique<MemorySource>(input.buffer->ptr, input.size);
+    }
+    return std::make_unique<FileSource>(input.path);
+}
+
+py::object decode_batch(const py::sequence& inputs, heif_colorspace colorspace,
+                        heif_chroma chroma, int threads, const DecodingOptions* options,
+                        int max_decoding_threads, const py::object& out,
+                        const CancelToken* cancel, MemoryBudget* budget,
+                        const SecurityLimits* limits) {
+    std::vector<BatchInput> items = collect_inputs(inputs);
+    const size_t count = items.size();
+
+    // Per-item views into the output batch (non-owning; the batch export keeps them valid)
+    std::unique_ptr<py::buffer_info> out_info;
+    std::vector<py::buffer_info> out_views;
+    if (!out.is_none()) {
+        out_info = std::make_unique<py::buffer_info>(out.cast<py::buffer>().request(true));
+        if (out_info->readonly || out_info->ndim < 3 ||
+            out_info->shape[0] != static_cast<py::ssize_t>(count)) {
+            throw std::invalid_argument(
+                "out must be a writable (N, height, width[, channels]) buffer with N == "
+                "len(inputs)");
+        }
+        std::vector<py::ssize_t> shape(out_info->shape.begin() + 1, out_info->shape.end());
+        std::vector<py::ssize_t> strides(out_info->strides.begin() + 1,
+                                         out_info->strides.end());
+        for (size_t i = 0; i < count; ++i) {
+            out_views.emplace_back(static_cast<uint8_t*>(out_info->ptr) +
+                                       static_cast<py::ssize_t>(i) * out_info->strides[0],
+                                   out_info->itemsize, out_info->format, out_info->ndim - 1,
+                                   shape, strides, false);
+        }
+    }
+
+    std::vector<std::shared_ptr<HeifImage>> images(count);
+    std::vector<std::exception_ptr> errors(count);
+
+    {
+        py::gil_scoped_release release;
+        parallel_for(count, threads, [&](size_t i) {
+            try {
+                DecodeCall call(options, cancel);
+                HandlePtr handle = open_primary(items[i], max_decoding_threads, limits);
+                BudgetLease lease(budget,
+                                  budget ? estimate_decode_bytes(handle.get(), colorspace, chroma,
+                                                                 max_decoding_threads)
+                                         : 0,
+                                  cancel);
+                auto image = std::make_shared<HeifImage>(
+                    call.decode(handle.get(), colorspace, chroma));
+                if (out_info) {
+                    copy_image_into(*image, out_views[i]);
+                } else {
+                    images[i] = std::move(image);
+                }
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+
+    for (auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    if (out_info) {
+        return out;
+    }
+    py::list result;
+    for (auto& image : images) {
+        result.append(py::cast(image));
+    }
+    return result;
+}
+
+std::vector<std::pair<std::string, std::string>> encoder_params_from_dict(const py::dict& params) {
+    std::vector<std::pair<std::string, std::string>> result;
+    for (auto item : params) {
+        py::handle value = item.second;
+        // libheif parses booleans as "true"/"false"; str(True) would be rejected
+        std::string text = py::isinstance<py::bool_>(value)
+                               ? (value.cast<bool>() ? "true" : "false")
+                               : py::str(value).cast<std::string>();
+        result.emplace_back(py::str(item.first).cast<std::string>(), text);
+    }
+    return result;
+}
+
+std::unique_ptr<HeifEncoder> make_encoder(const EncoderConfig& config) {
+    auto encoder = std::make_unique<HeifEncoder>(config.format);
+    if (config.quality >= 0) {
+        encoder->set_lossy_quality(config.quality);
+    }
+    for (const auto& param : config.params) {
+        encoder->set_parameter(param.first, param.second);
+    }
+    if (!config.preset.empty()) {
+        encoder->set_parameter("preset", config.preset);
+    }
+    return encoder;
+}
+
+py::object encode_batch(const std::vector<std::shared_ptr<HeifImage>>& images,
+                        heif_compression_format format, int quality, const py::dict& params,
+                        int threads, const std::string& preset, const EncodingOptions* options,
+                        const py::object& paths, const CancelToken* cancel) {
+    const size_t count = images.size();
+    for (const auto& image : images) {
+        if (!image) {
+            throw std::invalid_argument("encode_batch images must not be None");
+        }
+    }
+
+    EncoderConfig config{format, quality, encoder_params_from_dict(params), preset};
+
+    std::vector<std::string> out_paths;
+    if (!paths.is_none()) {
+        py::object fspath = py::module_::import("os").attr("fspath");
+        for (auto path : paths) {
+            out_paths.push_back(fspath(path).cast<std::string>());
+        }
+        if (out_paths.size() != count) {
+            throw std::invalid_argument("paths must have the same length as images");
+        }
+    }
+
+    // The first encoder is built here so bad formats or parameters fail before any work
+    const size_t workers = resolve_thread_count(threads, count);
+    std::vector<std::unique_ptr<HeifEncoder>> encoders(workers);
+    encoders[0] = make_encoder(config);
+
+    std::vector<std::vector<uint8_t>> outputs(out_paths.empty() ? count : 0);
+    std::vector<std::exception_ptr> errors(count);
+
+    {
+        py::gil_scoped_release release;
+        parallel_for_workers(count, workers, [&](size_t worker, size_t i) {
+            try {
+                if (!encoders[worker]) {
+                    encoders[worker] = make_encoder(config);
+                }
+                ContextPtr ctx(heif_context_alloc());
+                HandlePtr handle(
+                    encoders[worker]->encode(ctx.get(), *images[i], options, cancel));
+                if (out_paths.empty()) {
+                    write_context_to_vector(ctx.get(), outputs[i]);
+                } else {
+                    check_error(heif_context_write_to_file(ctx.get(), out_paths[i].c_str()));
+                }
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+        encoders.clear();
+    }
+
+    for (auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    if (!out_paths.empty()) {
+        return py::none();
+    }
+    py::list result;
+    for (auto& data : outputs) {
+        result.append(py::bytes(reinterpret_cast<const char*>(data.data()), data.size()));
+        std::vector<uint8_t>().swap(data);
+    }
+    return result;
+}
+
+}  // namespace pylibheif
@@ -0,0 +1,89 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common.hpp"
+
+namespace pylibheif {
+
+class ByteSource;
+class CancelToken;
+class MemoryBudget;
+struct SecurityLimits;
+class DecodingOptions;
+class EncodingOptions;
+class HeifEncoder;
+class HeifImage;
+
+// Owning wrappers for raw libheif objects used on native worker threads, where the Python
+// classes (which take and release the GIL) must not be used
+struct ContextDeleter {
+    void operator()(heif_context* ctx) const { heif_context_free(ctx); }
+};
+
+struct HandleDeleter {
+    void operator()(heif_image_handle* handle) const { heif_image_handle_release(handle); }
+};
+
+struct ImageDeleter {
+    void operator()(heif_image* image) const { heif_image_release(image); }
+};
+
+using ContextPtr = std::unique_ptr<heif_context, ContextDeleter>;
+using HandlePtr = std::unique_ptr<heif_image_handle, HandleDeleter>;
+using ImagePtr = std::unique_ptr<heif_image, ImageDeleter>;
+
+// One input file: either a path or an exported, contiguous buffer
+struct BatchInput {
+    std::string path;
+    std::unique_ptr<py::buffer_info> buffer;
+    size_t size = 0;
+};
+
+// Resolves a path (str / os.PathLike) or buffer object. Needs the GIL.
+BatchInput resolve_input(const py::handle& item, const char* caller);
+
+// Opens the input in a fresh context and returns its primary image handle. The handle keeps
+// the libheif context alive internally. Does not need the GIL.
+HandlePtr open_primary(const BatchInput& input, int max_decoding_threads,
+                       const SecurityLimits* limits = nullptr);
+// Lazy heif_reader source over the input (stdio for paths, in place for buffers)
+std::unique_ptr<ByteSource> open_source(const BatchInput& input);
+
+// Encoder settings resolved under the GIL and applied to encoders on worker threads
+struct EncoderConfig {
+    heif_compression_format format;
+    int quality;  // -1 = encoder default
+    std::vector<std::pair<std::string, std::string>> params;
+    std::string preset;
+};
+
+// Converts a dict of encoder parameters to strings. Needs the GIL.
+std::vector<std::pair<std::string, std::string>> encoder_params_from_dict(const py::dict& params);
+
+std::unique_ptr<HeifEncoder> make_encoder(const EncoderConfig& config);
+
+// Reads and decodes the primary image of every input (file path or buffer) on a pool of
+// `threads` native workers without the GIL. Returns a list of HeifImage in input order, or
+// fills `out` (shape (N, H, W[, C])) and returns it when given. Once `cancel` fires, running
+// decodes stop and items not yet started are skipped. With a budget, each item is opened
+// and its decode memory estimated first; the decode starts once that estimate fits.
+// `limits` applies to every context of the batch.
+py::object decode_batch(const py::sequence& inputs, heif_colorspace colorspace,
+                        heif_chroma chroma, int threads, const DecodingOptions* options,
+                        int max_decoding_threads, const py::object& out,
+                        const CancelToken* cancel, MemoryBudget* budget = nullptr,
+                        const SecurityLimits* limits = nullptr);
+
+// Encodes every image into its own single-image file on `threads` native workers. Each
+// worker configures one encoder (quality, params, preset) once and reuses it for all of its
+// images. Returns a list of bytes, or writes to `paths` and returns None when given.
+// `cancel` is checked before each image.
+py::object encode_batch(const std::vector<std::shared_ptr<HeifImage>>& images,
+                        heif_compression_format format, int quality, const py::dict& params,
+                        int threads, const std::string& preset, const EncodingOptions* options,
+                        const py::object& paths, const CancelToken* cancel);
+
+}  // namespace pylibheif
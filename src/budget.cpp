@@ -0,0 +1,209 @@
+#include "budget.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+#include "cancel.hpp"
+
+namespace pylibheif {
+
+MemoryBudget::MemoryBudget(uint64_t limit) : limit(limit) {
+    if (limit == 0) {
+        throw std::invalid_argument("MemoryBudget limit must be > 0");
+    }
+}
+
+void MemoryBudget::acquire(uint64_t bytes, const CancelToken* cancel) {
+    std::unique_lock<std::mutex> lock(mutex);
+    const uint64_t ticket = next_ticket++;
+    queue.push_back(ticket);
+    auto admissible = [&] {
+        return queue.front() == ticket && (used == 0 || bytes <= limit - std::min(used, limit));
+    };
+    while (!admissible()) {
+        if (cancel && cancel->is_canceled()) {
+            queue.erase(std::find(queue.begin(), queue.end(), ticket));
+            changed.notify_all();
+            lock.unlock();
+            throw_canceled();
+        }
+        // Tokens cannot notify, so a waiter with one polls for it (and for its deadline)
+        if (cancel) {
+            changed.wait_for(lock, std::chrono::milliseconds(10));
+        } else {
+            changed.wait(lock);
+        }
+    }
+    queue.pop_front();
+    used += bytes;
+    peak_used = std::max(peak_used, used);
+    ++admissions;
+    // The next waiter may fit as well
+    changed.notify_all();
+}
+
+void MemoryBudget::release(uint64_t bytes) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        used -= std::min(used, bytes);
+    }
+    changed.notify_all();
+}
+
+uint64_t MemoryBudget::get_limit() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return limit;
+}
+
+void MemoryBudget::set_limit(uint64_t value) {
+    if (value == 0) {
+        throw std::invalid_argument("MemoryBudget limit must be > 0");
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        limit = value;
+    }
+    changed.notify_all();
+}
+
+uint64_t MemoryBudget::in_use() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return used;
+}
+
+uint64_t MemoryBudget::peak() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return peak_used;
+}
+
+size_t MemoryBudget::waiting() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queue.size();
+}
+
+uint64_t MemoryBudget::admitted() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return admissions;
+}
+
+BudgetLease::BudgetLease(MemoryBudget* budget, uint64_t bytes, const CancelToken* cancel)
+    : budget(budget), bytes(bytes) {
+    if (budget) {
+        budget->acquire(bytes, cancel);
+    }
+}
+
+BudgetLease::~BudgetLease() {
+    if (budget) {
+        budget->release(bytes);
+    }
+}
+
+// Bytes of a width x height image in the given chroma; planar samples take 2 bytes above 8 bits
+static uint64_t image_size(uint64_t pixels, heif_chroma chroma, int bits, bool alpha) {
+    const uint64_t sample = bits > 8 ? 2 : 1;
+    switch (chroma) {
+        case heif_chroma_interleaved_RGB:
+            return pixels * 3;
+        case heif_chroma_interleaved_RGBA:
+            return pixels * 4;
+        case heif_chroma_interleaved_RRGGBB_BE:
+        case heif_chroma_interleaved_RRGGBB_LE:
+            return pixels * 6;
+        case heif_chroma_interleaved_RRGGBBAA_BE:
+        case heif_chroma_interleaved_RRGGBBAA_LE:
+            return pixels * 8;
+        default:
+            break;
+    }
+    // Planar: luma (or R) plus two chroma planes, counted in quarter samples per pixel
+    uint64_t quarters = 4;
+    if (chroma == heif_chroma_420) {
+        quarters += 2;
+    } else if (chroma == heif_chroma_422) {
+        quarters += 4;
+    } else if (chroma != heif_chroma_monochrome) {
+        quarters += 8;
+    }
+    if (alpha) {
+        quarters += 4;
+    }
+    return pixels * quarters * sample / 4;
+}
+
+uint64_t estimate_decode_bytes(const heif_image_handle* handle, heif_colorspace colorspace,
+                               heif_chroma chroma, int tile_threads) {
+    const uint64_t pixels = static_cast<uint64_t>(heif_image_handle_get_width(handle)) *
+                            static_cast<uint64_t>(heif_image_handle_get_height(handle));
+    const bool alpha = heif_image_handle_has_alpha_channel(handle) != 0;
+    const int bits = std::max(heif_image_handle_get_luma_bits_per_pixel(handle),
+                              heif_image_handle_get_chroma_bits_per_pixel(handle));
+
+    heif_colorspace native_colorspace = heif_colorspace_undefined;
+    heif_chroma native_chroma = heif_chroma_undefined;
+    heif_image_handle_get_preferred_decoding_colorspace(handle, &native_colorspace,
+                                                        &native_chroma);
+    if (native_chroma == heif_chroma_undefined) {
+        native_chroma = heif_chroma_444;
+    }
+    uint64_t total = image_size(pixels, native_chroma, bits, alpha);
+
+    // libheif converts into a second image unless the codec output is what was asked for
+    const bool converted = (chroma != heif_chroma_undefined && chroma != native_chroma) ||
+                           (colorspace != heif_colorspace_undefined &&
+                            colorspace != native_colorspace);
+    if (converted) {
+        total += image_size(pixels, chroma, bits, alpha);
+    }
+
+    // Grid tiles are decoded into their own images before being pasted into the full one
+    heif_image_tiling tiling;
+    if (heif_image_handle_get_image_tiling(handle, 1, &tiling).code == heif_error_Ok &&
+        uint64_t(tiling.num_columns) * tiling.num_rows > 1) {
+        const uint64_t tiles = uint64_t(tiling.num_columns) * tiling.num_rows;
+        const uint64_t threads = tile_threads < 0 ? 4 : std::max(tile_threads, 1);
+        const uint64_t tile_pixels = uint64_t(tiling.tile_width) * tiling.tile_height;
+        total += std::min(tiles, threads) * image_size(tile_pixels, native_chroma, bits, alpha);
+    }
+    return total;
+}
+
+SecurityLimits::SecurityLimits() : SecurityLimits(*heif_get_global_security_limits()) {}
+
+SecurityLimits::SecurityLimits(const heif_security_limits& limits)
+    : max_image_size_pixels(limits.max_image_size_pixels),
+      max_number_of_tiles(limits.max_number_of_tiles),
+      max_items(limits.max_items),
+      max_memory_block_size(limits.max_memory_block_size),
+      max_components(limits.max_components),
+      max_color_profile_size(limits.max_color_profile_size),
+      max_total_memory(0) {
+#if LIBHEIF_HAVE_VERSION(1, 20, 0)
+    max_total_memory = limits.max_total_memory;
+#endif
+}
+
+SecurityLimits SecurityLimits::disabled() {
+    return SecurityLimits(*heif_get_disabled_security_limits());
+}
+
+SecurityLimits SecurityLimits::of_context(const heif_context* ctx) {
+    return SecurityLimits(*heif_context_get_security_limits(ctx));
+}
+
+void SecurityLimits::apply_to(heif_context* ctx) const {
+    // Start from the context's limits so fields not exposed here keep their values
+    heif_security_limits limits = *heif_context_get_security_limits(ctx);
+    limits.max_image_size_pixels = max_image_size_pixels;
+    limits.max_number_of_tiles = max_number_of_tiles;
+    limits.max_items = max_items;
+    limits.max_memory_block_size = max_memory_block_size;
+    limits.max_components = max_components;
+    limits.max_color_profile_size = max_color_profile_size;
+#if LIBHEIF_HAVE_VERSION(1, 20, 0)
+    limits.max_total_memory = max_total_memory;
+#endif
+    check_error(heif_context_set_security_limits(ctx, &limits));
+}
+
+}  // namespace pylibheif
@@ -0,0 +1,85 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+#include "common.hpp"
+
+namespace pylibheif {
+
+class CancelToken;
+
+// Byte budget shared by concurrent decodes. Each decode reserves its estimated peak memory
+// before it starts and waits while the reservation would exceed the limit. Waiters are
+// admitted in arrival order, so a large image is not starved by a stream of small ones; a
+// reservation larger than the whole limit is admitted once nothing else holds any.
+class MemoryBudget {
+   public:
+    explicit MemoryBudget(uint64_t limit);
+
+    // Blocks until `bytes` fit; with a cancel token, stops waiting with the canceled
+    // HeifError once it fires. Must be called without the GIL.
+    void acquire(uint64_t bytes, const CancelToken* cancel = nullptr);
+    void release(uint64_t bytes);
+
+    uint64_t get_limit() const;
+    // Raising the limit admits waiters at once; lowering it only delays new admissions
+    void set_limit(uint64_t limit);
+    uint64_t in_use() const;
+    uint64_t peak() const;
+    size_t waiting() const;
+    uint64_t admitted() const;
+
+   private:
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    uint64_t limit;
+    uint64_t used = 0;
+    uint64_t peak_used = 0;
+    uint64_t admissions = 0;
+    uint64_t next_ticket = 0;
+    std::deque<uint64_t> queue;  // Tickets of the waiting reservations, oldest first
+};
+
+// Reservation held for the lifetime of the lease; a null budget makes it a no-op
+class BudgetLease {
+   public:
+    BudgetLease(MemoryBudget* budget, uint64_t bytes, const CancelToken* cancel = nullptr);
+    ~BudgetLease();
+
+    BudgetLease(const BudgetLease&) = delete;
+    BudgetLease& operator=(const BudgetLease&) = delete;
+
+   private:
+    MemoryBudget* budget;
+    uint64_t bytes;
+};
+
+// Estimated peak bytes of decoding the handle to colorspace/chroma, from its size, bit depth
+// and alpha: the codec output in the native chroma, the converted image when the request
+// differs from it, and one native tile per tile-decoding thread for grid images.
+// tile_threads < 0 means libheif's default.
+uint64_t estimate_decode_bytes(const heif_image_handle* handle, heif_colorspace colorspace,
+                               heif_chroma chroma, int tile_threads = -1);
+
+// libheif's per-context security limits; 0 disables a limit. Defaults to the global limits.
+struct SecurityLimits {
+    uint64_t max_image_size_pixels;
+    uint64_t max_number_of_tiles;
+    uint32_t max_items;
+    uint64_t max_memory_block_size;
+    uint32_t max_components;
+    uint32_t max_color_profile_size;
+    uint64_t max_total_memory;  // Sum of the context's live allocations
+
+    SecurityLimits();
+    static SecurityLimits disabled();
+    static SecurityLimits of_context(const heif_context* ctx);
+    void apply_to(heif_context* ctx) const;
+
+   private:
+    explicit SecurityLimits(const heif_security_limits& limits);
+};
+
+}  // namespace pylibheif
@@ -0,0 +1,65 @@
+#include "cancel.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace pylibheif {
+
+static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+CancelToken::CancelToken(std::optional<double> deadline_ms) { set_deadline_ms(deadline_ms); }
+
+std::shared_ptr<CancelToken> CancelToken::child(std::optional<double> deadline_ms) {
+    auto token = std::make_shared<CancelToken>(deadline_ms);
+    token->parent = shared_from_this();
+    return token;
+}
+
+bool CancelToken::is_canceled() const {
+    if (canceled.load(std::memory_order_relaxed) || (parent && parent->is_canceled())) {
+        return true;
+    }
+    const int64_t deadline = deadline_ns.load(std::memory_order_relaxed);
+    return deadline != INT64_MAX && now_ns() >= deadline;
+}
+
+void CancelToken::set_deadline_ms(std::optional<double> deadline_ms) {
+    if (deadline_ms && *deadline_ms < 0) {
+        throw std::invalid_argument("deadline_ms must be >= 0");
+    }
+    deadline_ns.store(deadline_ms ? now_ns() + static_cast<int64_t>(*deadline_ms * 1e6)
+                                  : INT64_MAX,
+                      std::memory_order_relaxed);
+}
+
+std::optional<double> CancelToken::remaining_ms() const {
+    std::optional<double> inherited = parent ? parent->remaining_ms() : std::nullopt;
+    const int64_t deadline = deadline_ns.load(std::memory_order_relaxed);
+    if (deadline == INT64_MAX) {
+        return inherited;
+    }
+    const int64_t left = deadline - now_ns();
+    const double own = left > 0 ? left / 1e6 : 0.0;
+    return inherited ? std::min(own, *inherited) : own;
+}
+
+void CancelToken::check() const {
+    if (is_canceled()) {
+        throw_canceled();
+    }
+}
+
+void throw_canceled() {
+#ifdef PYLIBHEIF_HAVE_CANCEL_DECODING
+    const heif_error_code code = heif_error_Canceled;
+#else
+    const heif_error_code code = heif_error_Usage_error;
+#endif
+    throw HeifError(heif_error{code, heif_suberror_Unspecified, "Operation was canceled"});
+}
+
+}  // namespace pylibheif
@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "common.hpp"
+
+// libheif polls heif_decoding_options::cancel_decoding since 1.19; older versions can only
+// be stopped before a decode starts
+#if LIBHEIF_HAVE_VERSION(1, 19, 0)
+#define PYLIBHEIF_HAVE_CANCEL_DECODING 1
+#endif
+
+namespace pylibheif {
+
+// Thread-safe cancellation flag with an optional deadline, shared by the caller and any
+// number of running decodes/encodes. Long operations poll it between tiles, images and
+// encoder attempts and fail with a "canceled" HeifError once it has fired.
+class CancelToken : public std::enable_shared_from_this<CancelToken> {
+   public:
+    // deadline_ms is relative to now; nullopt means no deadline
+    explicit CancelToken(std::optional<double> deadline_ms = std::nullopt);
+
+    // Token that also fires when this one does, with its own flag and deadline, so a single
+    // call can be given a deadline (or be canceled) without touching the caller's token
+    std::shared_ptr<CancelToken> child(std::optional<double> deadline_ms = std::nullopt);
+
+    void cancel() { canceled.store(true, std::memory_order_relaxed); }
+    // True once cancel() was called or the deadline has passed
+    bool is_canceled() const;
+    void set_deadline_ms(std::optional<double> deadline_ms);
+    // Milliseconds left until the deadline (never negative), or nullopt without one
+    std::optional<double> remaining_ms() const;
+
+    // Throws the canceled HeifError if the token has fired
+    void check() const;
+
+   private:
+    std::atomic<bool> canceled{false};
+    // steady_clock time in nanoseconds; INT64_MAX means no deadline
+    std::atomic<int64_t> deadline_ns{INT64_MAX};
+    std::shared_ptr<const CancelToken> parent;
+};
+
+// Throws HeifError with the canceled code
+[[noreturn]] void throw_canceled();
+
+inline void check_canceled(const CancelToken* token) {
+    if (token) {
+        token->check();
+    }
+}
+
+}  // namespace pylibheif
@@ -2,11 +2,21 @@
 #include <libheif/heif.h>
 #include <pybind11/pybind11.h>
 
+#include <cstdint>
 #include <stdexcept>
 #include <string>
 
 namespace py = pybind11;
 
+// Marks hot loops that compilers auto-vectorize. On x86-64 Linux an AVX2 clone is built next
+// to the baseline (SSE2) version and picked at load time; NEON is part of the aarch64
+// baseline and needs no dispatch.
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+#define PYLIBHEIF_TARGET_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define PYLIBHEIF_TARGET_CLONES
+#endif
+
 namespace pylibheif {
 
 class HeifError : public std::runtime_error {
@@ -24,4 +34,50 @@ inline void check_error(const heif_error& err) {
     }
 }
 
+// Releases a memoryview over libheif-owned memory on every path (the GIL must be held), so
+// a view that Python code kept, or that a raised exception's traceback still references,
+// cannot outlive the buffer
+struct ReleaseViewGuard {
+    py::memoryview& view;
+    const char* context;
+    ~ReleaseViewGuard() {
+        try {
+            view.attr("release")();
+        } catch (py::error_already_set& e) {
+            e.discard_as_unraisable(context);
+        }
+    }
+};
+
+// Value type mirroring heif_color_profile_nclx
+struct NclxColorProfile {
+    heif_color_primaries color_primaries = heif_color_primaries_unspecified;
+    heif_transfer_characteristics transfer_characteristics =
+        heif_transfer_characteristic_unspecified;
+    heif_matrix_coefficients matrix_coefficients = heif_matrix_coefficients_unspecified;
+    bool full_range = true;
+};
+
+inline NclxColorProfile nclx_from_heif(const heif_color_profile_nclx* nclx) {
+    NclxColorProfile profile;
+    profile.color_primaries = nclx->color_primaries;
+    profile.transfer_characteristics = nclx->transfer_characteristics;
+    profile.matrix_coefficients = nclx->matrix_coefficients;
+    profile.full_range = nclx->full_range_flag != 0;
+    return profile;
+}
+
+inline bool host_is_little_endian() {
+    const uint16_t probe = 1;
+    return *reinterpret_cast<const uint8_t*>(&probe) == 1;
+}
+
+// 16-bit interleaved RGB(A) chroma whose samples are in host byte order
+inline heif_chroma native_hdr_chroma(bool alpha) {
+    if (host_is_little_endian()) {
+        return alpha ? heif_chroma_interleaved_RRGGBBAA_LE : heif_chroma_interleaved_RRGGBB_LE;
+    }
+    return alpha ? heif_chroma_interleaved_RRGGBBAA_BE : heif_chroma_interleaved_RRGGBB_BE;
+}
+
 }  // namespace pylibheif
@@ -1,6 +1,17 @@
 #include "context.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+
+#include "batch.hpp"
+#include "budget.hpp"
+#include "decoder.hpp"
 #include "image.hpp"
+#include "reader.hpp"
+#include "stats.hpp"
+#include "thread_pool.hpp"
 
 namespace pylibheif {
 
@@ -12,28 +23,121 @@ HeifContext::~HeifContext() {
     if (ctx) {
         heif_context_free(ctx);
     }
+    if (memory_buffer || reader_source) {
+        // Releasing the exported view or stream touches Python objects
+        py::gil_scoped_acquire acquire;
+        memory_buffer.reset();
+        reader_source.reset();
+    }
+}
+
+void HeifContext::discard_failed_read() {
+    // libheif may still point into the input of a failed read, so the context is replaced
+    // before the input is released; the settings made on it carry over
+    heif_context* fresh = heif_context_alloc();
+    heif_context_set_security_limits(fresh, heif_context_get_security_limits(ctx));
+    if (*max_decoding_threads >= 0) {
+        heif_context_set_max_decoding_threads(fresh, *max_decoding_threads);
+    }
+    heif_context_free(ctx);
+    ctx = fresh;
 }
 
 void HeifContext::read_from_file(const std::string& filename) {
     py::gil_scoped_release release;
+    ScopedTimer timer(Stage::Read);
     check_error(heif_context_read_from_file(ctx, filename.c_str(), nullptr));
+    if (timer.enabled()) {
+        std::error_code ec;
+        const auto size = std::filesystem::file_size(filename, ec);
+        timer.add_bytes(ec ? 0 : size);
+    }
 }
 
-void HeifContext::read_from_memory(const py::bytes& data) {
-    if (!memory_data.empty()) {
+// libheif reads and writes files as one flat byte range, so buffers must be C-contiguous
+static size_t contiguous_size(const py::buffer_info& info, const char* caller) {
+    py::ssize_t expected_stride = info.itemsize;
+    for (py::ssize_t i = info.ndim - 1; i >= 0; --i) {
+        if (info.shape[i] > 1 && info.strides[i] != expected_stride) {
+            throw std::invalid_argument(std::string(caller) + " requires a C-contiguous buffer");
+        }
+        expected_stride *= info.shape[i];
+    }
+    return static_cast<size_t>(info.size * info.itemsize);
+}
+
+void HeifContext::read_from_memory(const py::buffer& data) {
+    if (memory_buffer || reader_source) {
         throw std::runtime_error("Context already initialized with memory data");
     }
-    memory_data = std::string(data);  // Store in member to ensure data outlives context
 
-    py::gil_scoped_release release;
-    check_error(heif_context_read_from_memory_without_copy(ctx, memory_data.data(),
-                                                           memory_data.size(), nullptr));
+    auto info = std::make_unique<py::buffer_info>(data.request());
+    size_t size = contiguous_size(*info, "read_from_memory");
+    const void* ptr = info->ptr;
+
+    // Keep the exported view (and thus the Python object) alive instead of copying it
+    memory_buffer = std::move(info);
+
+    try {
+        py::gil_scoped_release release;
+        ScopedTimer timer(Stage::Read);
+        check_error(heif_context_read_from_memory_without_copy(ctx, ptr, size, nullptr));
+        timer.add_bytes(size);
+    } catch (...) {
+        // The caller's buffer must not stay exported (and locked) by a context that failed
+        discard_failed_read();
+        memory_buffer.reset();
+        throw;
+    }
+}
+
+void HeifContext::read_from_source(std::unique_ptr<ByteSource>& source) {
+    if (memory_buffer || reader_source) {
+        throw std::runtime_error("Context already initialized with memory data");
+    }
+    ByteSource* raw = source.get();
+
+    try {
+        py::gil_scoped_release release;
+        ScopedTimer timer(Stage::Read);
+        check_error(heif_context_read_from_reader(ctx, byte_source_reader(), raw, nullptr));
+        // Lazy readers fetch the remaining ranges during decoding; only the parse is counted
+        timer.add_bytes(raw->bytes_read);
+    } catch (...) {
+        discard_failed_read();
+        throw;
+    }
+    reader_source = std::move(source);
+}
+
+void HeifContext::read_from_mmap(const std::string& filename) {
+    std::unique_ptr<ByteSource> source;
+    {
+        py::gil_scoped_release release;
+        source = std::make_unique<MmapSource>(filename);
+    }
+    read_from_source(source);
+}
+
+void HeifContext::read_from_stream(const py::object& fileobj) {
+    auto stream_source = std::make_unique<PythonStreamSource>(fileobj);
+    auto* stream = stream_source.get();
+    std::unique_ptr<ByteSource> source = std::move(stream_source);
+    try {
+        read_from_source(source);
+    } catch (const HeifError&) {
+        // Surface the Python error (e.g. OSError from the stream) instead of libheif's
+        if (stream->error) {
+            std::rethrow_exception(stream->error);
+        }
+        throw;
+    }
 }
 
 std::shared_ptr<HeifImageHandle> HeifContext::get_primary_image_handle() {
     heif_image_handle* handle;
     check_error(heif_context_get_primary_image_handle(ctx, &handle));
-    return std::make_shared<HeifImageHandle>(handle);
+    return std::make_shared<HeifImageHandle>(handle, max_decoding_threads);
 }
 
 std::vector<heif_item_id> HeifContext::get_list_of_top_level_image_IDs() {
@@ -46,24 +150,83 @@ std::vector<heif_item_id> HeifContext::get_list_of_top_level_image_IDs() {
 std::shared_ptr<HeifImageHandle> HeifContext::get_image_handle(heif_item_id id) {
     heif_image_handle* handle;
     check_error(heif_context_get_image_handle(ctx, id, &handle));
-    return std::make_shared<HeifImageHandle>(handle);
+    return std::make_shared<HeifImageHandle>(handle, max_decoding_threads);
 }
 
+std::vector<std::shared_ptr<HeifImage>> HeifContext::decode_all(
+    const std::optional<std::vector<heif_item_id>>& ids, heif_colorspace colorspace,
+    heif_chroma chroma, int threads, const DecodingOptions* options,
+    const CancelToken* cancel, MemoryBudget* budget) {
+    const std::vector<heif_item_id> items = ids ? *ids : get_list_of_top_level_image_IDs();
+
+    // Handles are looked up up front so an unknown id fails before any decoding starts
+    std::vector<HandlePtr> handles;
+    handles.reserve(items.size());
+    for (heif_item_id id : items) {
+        heif_image_handle* handle;
+        check_error(heif_context_get_image_handle(ctx, id, &handle));
+        handles.emplace_back(handle);
+    }
+
+    std::vector<std::shared_ptr<HeifImage>> images(items.size());
+    std::vector<std::exception_ptr> errors(items.size());
+    {
+        py::gil_scoped_release release;
+        parallel_for(items.size(), threads, [&](size_t i) {
+            try {
+                BudgetLease lease(budget,
+                                  budget ? estimate_decode_bytes(handles[i].get(), colorspace,
+                                                                 chroma, *max_decoding_threads)
+                                         : 0,
+                                  cancel);
+                DecodeCall call(options, cancel);
+                images[i] = std::make_shared<HeifImage>(
+                    call.decode(handles[i].get(), colorspace, chroma));
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+
+    for (auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    return images;
+}
+
+void HeifContext::set_max_decoding_threads(int threads) {
+    if (threads < 0) {
+        throw std::invalid_argument("max_decoding_threads must be >= 0");
+    }
+    heif_context_set_max_decoding_threads(ctx, threads);
+    *max_decoding_threads = threads;
+}
+
+SecurityLimits HeifContext::get_security_limits() const {
+    return SecurityLimits::of_context(ctx);
+}
+
+void HeifContext::set_security_limits(const SecurityLimits& limits) { limits.apply_to(ctx); }
+
 void HeifContext::write_to_file(const std::string& filename) {
     py::gil_scoped_release release;
+    ScopedTimer timer(Stage::Serialize);
     check_error(heif_context_write_to_file(ctx, filename.c_str()));
+    if (timer.enabled()) {
+        std::error_code ec;
+        const auto size = std::filesystem::file_size(filename, ec);
+        timer.add_bytes(ec ? 0 : size);
+    }
 }
 
-struct WriterData {
-    std::vector<uint8_t> data;
-};
-
 static struct heif_error writer_write(struct heif_context* ctx, const void* data, size_t size,
                                       void* userdata) {
     try {
-        WriterData* wd = (WriterData*)userdata;
+        auto* out = static_cast<std::vector<uint8_t>*>(userdata);
         const uint8_t* bytes = (const uint8_t*)data;
-        wd->data.insert(wd->data.end(), bytes, bytes + size);
+        out->insert(out->end(), bytes, bytes + size);
     } catch (...) {
         struct heif_error err = {heif_error_Memory_allocation_error, heif_suberror_Unspecified,
                                  "Memory allocation failed during write"};
@@ -74,18 +237,134 @@ static struct heif_error writer_write(struct heif_context* ctx, const void* data
     return err;
 }
 
-py::bytes HeifContext::write_to_bytes() {
-    WriterData wd;
+void write_context_to_vector(heif_context* ctx, std::vector<uint8_t>& out) {
     struct heif_writer writer = {};  // Zero-initialize all fields
     writer.writer_api_version = 1;
     writer.write = writer_write;
+    ScopedTimer timer(Stage::Serialize);
+    const size_t start = out.size();
+    check_error(heif_context_write(ctx, &writer, &out));
+    timer.add_bytes(out.size() - start);
+}
+
+py::bytes HeifContext::write_to_bytes() {
+    std::vector<uint8_t> data;
+    {
+        py::gil_scoped_release release;
+        write_context_to_vector(ctx, data);
+    }
+
+    return py::bytes((char*)data.data(), data.size());
+}
+
+struct StreamWriterData {
+    py::object write;
+    size_t written = 0;
+    std::exception_ptr error;
+};
+
+static struct heif_error stream_writer_write(struct heif_context* ctx, const void* data,
+                                             size_t size, void* userdata) {
+    auto* wd = static_cast<StreamWriterData*>(userdata);
+    try {
+        py::gil_scoped_acquire acquire;
+        const char* bytes = static_cast<const char*>(data);
+        size_t offset = 0;
+        while (offset < size) {
+            // Hand the chunk to Python without copying; the view is only valid during write()
+            py::memoryview chunk = py::memoryview::from_memory(
+                bytes + offset, static_cast<py::ssize_t>(size - offset));
+            ReleaseViewGuard guard{chunk, "pylibheif: releasing the write() chunk"};
+            py::object result = wd->write(chunk);
+
+            // Raw streams may accept only part of the chunk; None means everything was taken
+            size_t accepted = result.is_none() ? size - offset : result.cast<size_t>();
+            if (accepted == 0) {
+                throw std::runtime_error("write() accepted no data");
+            }
+            offset += accepted;
+        }
+        wd->written += size;
+    } catch (...) {
+        wd->error = std::current_exception();
+        struct heif_error err = {heif_error_Usage_error, heif_suberror_Unspecified,
+                                 "Python write() failed"};
+        return err;
+    }
+
+    struct heif_error err = {heif_error_Ok, heif_suberror_Unspecified, "Success"};
+    return err;
+}
+
+size_t HeifContext::write_to(const py::object& fileobj) {
+    StreamWriterData wd;
+    wd.write = fileobj.attr("write");
+
+    struct heif_writer writer = {};
+    writer.writer_api_version = 1;
+    writer.write = stream_writer_write;
 
+    heif_error err;
     {
         py::gil_scoped_release release;
+        ScopedTimer timer(Stage::Serialize);
+        err = heif_context_write(ctx, &writer, &wd);
+        timer.add_bytes(wd.written);
+    }
+
+    if (wd.error) {
+        std::rethrow_exception(wd.error);
+    }
+    check_error(err);
+    return wd.written;
+}
+
+struct BufferWriterData {
+    uint8_t* data;
+    size_t capacity;
+    size_t required = 0;
+};
+
+static struct heif_error buffer_writer_write(struct heif_context* ctx, const void* data,
+                                             size_t size, void* userdata) {
+    auto* wd = static_cast<BufferWriterData*>(userdata);
+    // Keep counting past the end so the caller can be told how much space is needed
+    if (wd->required + size <= wd->capacity) {
+        memcpy(wd->data + wd->required, data, size);
+    }
+    wd->required += size;
+
+    struct heif_error err = {heif_error_Ok, heif_suberror_Unspecified, "Success"};
+    return err;
+}
+
+size_t HeifContext::write_into(const py::buffer& buffer) {
+    py::buffer_info info = buffer.request(true);
+    if (info.readonly) {
+        throw std::invalid_argument("write_into requires a writable buffer");
+    }
+
+    BufferWriterData wd;
+    wd.data = static_cast<uint8_t*>(info.ptr);
+    wd.capacity = contiguous_size(info, "write_into");
+
+    struct heif_writer writer = {};
+    writer.writer_api_version = 1;
+    writer.write = buffer_writer_write;
+
+    {
+        py::gil_scoped_release release;
+        ScopedTimer timer(Stage::Serialize);
         check_error(heif_context_write(ctx, &writer, &wd));
+        timer.add_bytes(std::min(wd.required, wd.capacity));
     }
 
-    return py::bytes((char*)wd.data.data(), wd.data.size());
+    if (wd.required > wd.capacity) {
+        throw std::length_error("Buffer too small: " + std::to_string(wd.required) +
+                                " bytes required, " + std::to_string(wd.capacity) +
+                                " available");
+    }
+    return wd.required;
 }
 
 void HeifContext::add_exif_metadata(std::shared_ptr<HeifImageHandle> handle,
@@ -1,5 +1,7 @@
 #pragma once
+#include <atomic>
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -7,7 +9,16 @@
 
 namespace pylibheif {
 
+class ByteSource;
+class CancelToken;
+class DecodingOptions;
+class HeifImage;
 class HeifImageHandle;
+class MemoryBudget;
+struct SecurityLimits;
+
+// Serializes a raw context into `out`. Does not touch Python state.
+void write_context_to_vector(heif_context* ctx, std::vector<uint8_t>& out);
 
 class HeifContext {
    public:
@@ -15,14 +26,39 @@ class HeifContext {
     ~HeifContext();
 
     void read_from_file(const std::string& filename);
-    void read_from_memory(const py::bytes& data);
+    void read_from_memory(const py::buffer& data);
+    // Lazy readers: libheif pulls only the byte ranges it needs, now and during later decodes
+    void read_from_mmap(const std::string& filename);
+    void read_from_stream(const py::object& fileobj);
 
     std::shared_ptr<HeifImageHandle> get_primary_image_handle();
     std::vector<heif_item_id> get_list_of_top_level_image_IDs();
     std::shared_ptr<HeifImageHandle> get_image_handle(heif_item_id id);
 
+    // Decodes the given images (default: all top-level images) on `threads` native workers
+    // without the GIL. Handles of one context may be decoded concurrently; libheif
+    // serializes its reads from the shared file. With a budget, each worker waits until
+    // its image's estimated decode memory fits.
+    std::vector<std::shared_ptr<HeifImage>> decode_all(
+        const std::optional<std::vector<heif_item_id>>& ids, heif_colorspace colorspace,
+        heif_chroma chroma, int threads, const DecodingOptions* options,
+        const CancelToken* cancel = nullptr, MemoryBudget* budget = nullptr);
+
+    // Upper bound on threads libheif uses to decode tiles of one image (0 = no threading)
+    int get_max_decoding_threads() const { return *max_decoding_threads; }
+    void set_max_decoding_threads(int threads);
+
+    // libheif rejects files exceeding these while reading and decoding; set them before
+    // reading a file
+    SecurityLimits get_security_limits() const;
+    void set_security_limits(const SecurityLimits& limits);
+
     void write_to_file(const std::string& filename);
     py::bytes write_to_bytes();
+    // Streams the encoded file to fileobj.write(); returns the number of bytes written
+    size_t write_to(const py::object& fileobj);
+    // Writes the encoded file into a caller-owned writable buffer; returns its size
+    size_t write_into(const py::buffer& buffer);
 
     // Metadata writing
     void add_exif_metadata(std::shared_ptr<HeifImageHandle> handle, const py::bytes& data);
@@ -34,8 +70,19 @@ class HeifContext {
 
    private:
     heif_context* ctx;
-    // Store memory data to ensure it outlives the context
-    std::string memory_data;
+    // Shared with the handles, whose decode estimates depend on it (-1 = libheif default)
+    std::shared_ptr<std::atomic<int>> max_decoding_threads =
+        std::make_shared<std::atomic<int>>(-1);
+    // Exported view of the caller's buffer; keeps the object alive (and, for
+    // resizable objects such as bytearray, locked) for as long as the context
+    std::unique_ptr<py::buffer_info> memory_buffer;
+    // Backing store of a lazy reader; libheif keeps reading from it until the context is freed
+    std::unique_ptr<ByteSource> reader_source;
+
+    // Takes ownership of source once the read succeeds; after a failure the caller keeps it
+    void read_from_source(std::unique_ptr<ByteSource>& source);
+    // Swaps in a fresh libheif context after a failed read so the input can be released
+    void discard_failed_read();
 };
 
 }  // namespace pylibheif
@@ -0,0 +1,184 @@
+#include "decoder.hpp"
+
+#include "cancel.hpp"
+#include "stats.hpp"
+
+namespace pylibheif {
+
+// HeifDecoderDescriptor
+HeifDecoderDescriptor::HeifDecoderDescriptor(const heif_decoder_descriptor* descriptor)
+    : descriptor(descriptor) {}
+
+std::string HeifDecoderDescriptor::id_name() const {
+    return heif_decoder_descriptor_get_id_name(descriptor);
+}
+
+std::string HeifDecoderDescriptor::name() const {
+    return heif_decoder_descriptor_get_name(descriptor);
+}
+
+std::vector<HeifDecoderDescriptor> get_decoder_descriptors(heif_compression_format format_filter) {
+    int count = heif_get_decoder_descriptors(format_filter, nullptr, 0);
+
+    std::vector<HeifDecoderDescriptor> result;
+    if (count > 0) {
+        std::vector<const heif_decoder_descriptor*> descriptors(count);
+        count = heif_get_decoder_descriptors(format_filter, descriptors.data(), count);
+
+        for (int i = 0; i < count; ++i) {
+            result.emplace_back(descriptors[i]);
+        }
+    }
+    return result;
+}
+
+// DecodingOptions
+DecodingOptions::DecodingOptions() : options(heif_decoding_options_alloc()) {}
+
+DecodingOptions::~DecodingOptions() {
+    if (options) {
+        heif_decoding_options_free(options);
+    }
+}
+
+bool DecodingOptions::get_ignore_transformations() const {
+    return options->ignore_transformations != 0;
+}
+
+void DecodingOptions::set_ignore_transformations(bool value) {
+    options->ignore_transformations = value ? 1 : 0;
+}
+
+bool DecodingOptions::get_convert_hdr_to_8bit() const { return options->convert_hdr_to_8bit != 0; }
+
+void DecodingOptions::set_convert_hdr_to_8bit(bool value) {
+    options->convert_hdr_to_8bit = value ? 1 : 0;
+}
+
+bool DecodingOptions::get_strict_decoding() const { return options->strict_decoding != 0; }
+
+void DecodingOptions::set_strict_decoding(bool value) { options->strict_decoding = value ? 1 : 0; }
+
+void DecodingOptions::set_decoder_id(const std::string& id) {
+    decoder_id = id;
+    options->decoder_id = decoder_id.empty() ? nullptr : decoder_id.c_str();
+}
+
+heif_chroma_upsampling_algorithm DecodingOptions::get_chroma_upsampling() const {
+    return options->color_conversion_options.preferred_chroma_upsampling_algorithm;
+}
+
+void DecodingOptions::set_chroma_upsampling(heif_chroma_upsampling_algorithm algorithm) {
+    options->color_conversion_options.preferred_chroma_upsampling_algorithm = algorithm;
+}
+
+heif_chroma_downsampling_algorithm DecodingOptions::get_chroma_downsampling() const {
+    return options->color_conversion_options.preferred_chroma_downsampling_algorithm;
+}
+
+void DecodingOptions::set_chroma_downsampling(heif_chroma_downsampling_algorithm algorithm) {
+    options->color_conversion_options.preferred_chroma_downsampling_algorithm = algorithm;
+}
+
+bool DecodingOptions::get_only_use_preferred_chroma_algorithm() const {
+    return options->color_conversion_options.only_use_preferred_chroma_algorithm != 0;
+}
+
+void DecodingOptions::set_only_use_preferred_chroma_algorithm(bool value) {
+    options->color_conversion_options.only_use_preferred_chroma_algorithm = value ? 1 : 0;
+}
+
+void DecodingOptions::set_progress(const py::object& callback) {
+    if (!callback.is_none() && !PyCallable_Check(callback.ptr())) {
+        throw py::type_error("progress must be callable or None");
+    }
+    progress = callback;
+}
+
+// DecodeCall
+DecodeCall::DecodeCall(const DecodingOptions* source, const CancelToken* cancel)
+    : options(heif_decoding_options_alloc(), heif_decoding_options_free), cancel(cancel) {
+    check_canceled(cancel);
+    if (source) {
+        *options = *source->get();
+        if (!source->get_progress().is_none()) {
+            progress = &source->get_progress();
+        }
+    }
+    if (progress) {
+        options->start_progress = &DecodeCall::start_progress;
+        options->on_progress = &DecodeCall::on_progress;
+        options->end_progress = &DecodeCall::end_progress;
+    }
+#ifdef PYLIBHEIF_HAVE_CANCEL_DECODING
+    options->cancel_decoding = &DecodeCall::cancel_decoding;
+#endif
+    options->progress_user_data = this;
+}
+
+void DecodeCall::check(const heif_error& err, heif_image* img) const {
+    if (progress_error) {
+        if (err.code == heif_error_Ok && img) {
+            heif_image_release(img);
+        }
+        std::rethrow_exception(progress_error);
+    }
+    if (err.code != heif_error_Ok && cancel && cancel->is_canceled()) {
+        throw_canceled();
+    }
+    check_error(err);
+}
+
+heif_image* DecodeCall::decode(const heif_image_handle* handle, heif_colorspace colorspace,
+                               heif_chroma chroma, const heif_decoding_options* opts) const {
+    ScopedTimer timer(Stage::Decode);
+    if (!opts) {
+        opts = options.get();
+    }
+    heif_image* img = nullptr;
+    const heif_error err = heif_decode_image(handle, &img, colorspace, chroma, opts);
+    check(err, img);
+    if (timer.enabled()) {
+        timer.add_bytes(image_bytes(img));
+        record_plugin("decoder", opts->decoder_id ? opts->decoder_id : "default");
+    }
+    return img;
+}
+
+void DecodeCall::report(heif_progress_step step, int value, int max_value) {
+    // The GIL also serializes callbacks coming from libheif's tile threads
+    py::gil_scoped_acquire acquire;
+    if (progress_error) {
+        return;
+    }
+    int& step_max = max_progress[step == heif_progress_step_load_tile ? 1 : 0];
+    if (max_value >= 0) {
+        step_max = max_value;
+    }
+    try {
+        (*progress)(step, value >= 0 ? value : step_max, step_max);
+    } catch (...) {
+        // libheif cannot propagate it; the decode is canceled and check() re-raises it
+        progress_error = std::current_exception();
+        progress_failed = true;
+    }
+}
+
+void DecodeCall::start_progress(heif_progress_step step, int max_progress, void* user_data) {
+    static_cast<DecodeCall*>(user_data)->report(step, 0, max_progress);
+}
+
+void DecodeCall::on_progress(heif_progress_step step, int progress, void* user_data) {
+    static_cast<DecodeCall*>(user_data)->report(step, progress, -1);
+}
+
+void DecodeCall::end_progress(heif_progress_step step, void* user_data) {
+    static_cast<DecodeCall*>(user_data)->report(step, -1, -1);
+}
+
+int DecodeCall::cancel_decoding(void* user_data) {
+    auto* call = static_cast<DecodeCall*>(user_data);
+    return call->progress_failed || (call->cancel && call->cancel->is_canceled()) ? 1 : 0;
+}
+
+}  // namespace pylibheif
@@ -0,0 +1,114 @@
+#pragma once
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common.hpp"
+
+namespace pylibheif {
+
+class CancelToken;
+
+class HeifDecoderDescriptor {
+   public:
+    HeifDecoderDescriptor(const heif_decoder_descriptor* descriptor);
+
+    std::string id_name() const;
+    std::string name() const;
+
+    const heif_decoder_descriptor* get() const { return descriptor; }
+
+   private:
+    const heif_decoder_descriptor* descriptor;
+};
+
+std::vector<HeifDecoderDescriptor> get_decoder_descriptors(
+    heif_compression_format format_filter = heif_compression_undefined);
+
+// Reusable set of heif_decoding_options. The object is read-only while a decode is
+// running, so one instance can be shared by decodes on several threads.
+class DecodingOptions {
+   public:
+    DecodingOptions();
+    ~DecodingOptions();
+
+    DecodingOptions(const DecodingOptions&) = delete;
+    DecodingOptions& operator=(const DecodingOptions&) = delete;
+
+    bool get_ignore_transformations() const;
+    void set_ignore_transformations(bool value);
+
+    bool get_convert_hdr_to_8bit() const;
+    void set_convert_hdr_to_8bit(bool value);
+
+    bool get_strict_decoding() const;
+    void set_strict_decoding(bool value);
+
+    // Empty string lets libheif pick the decoder
+    std::string get_decoder_id() const { return decoder_id; }
+    void set_decoder_id(const std::string& id);
+
+    heif_chroma_upsampling_algorithm get_chroma_upsampling() const;
+    void set_chroma_upsampling(heif_chroma_upsampling_algorithm algorithm);
+
+    heif_chroma_downsampling_algorithm get_chroma_downsampling() const;
+    void set_chroma_downsampling(heif_chroma_downsampling_algorithm algorithm);
+
+    bool get_only_use_preferred_chroma_algorithm() const;
+    void set_only_use_preferred_chroma_algorithm(bool value);
+
+    // Python callable(step, progress, max_progress) driven by libheif's progress hooks; it is
+    // called with the GIL from the decoding thread. None disables it.
+    const py::object& get_progress() const { return progress; }
+    void set_progress(const py::object& callback);
+
+    const heif_decoding_options* get() const { return options; }
+
+   private:
+    heif_decoding_options* options;
+    // Owns the string that options->decoder_id points to
+    std::string decoder_id;
+    py::object progress;
+};
+
+// Per-call copy of the decoding options whose progress and cancel hooks report to the
+// options' progress callback and to a CancelToken. Throws right away if the token has
+// already fired. Does not need the GIL.
+class DecodeCall {
+   public:
+    DecodeCall(const DecodingOptions* options, const CancelToken* cancel);
+
+    DecodeCall(const DecodeCall&) = delete;
+    DecodeCall& operator=(const DecodeCall&) = delete;
+
+    const heif_decoding_options* get() const { return options.get(); }
+
+    // heif_decode_image followed by check(), recorded as the "decode" stage. opts overrides
+    // get() for callers that adjust a copy of the options.
+    heif_image* decode(const heif_image_handle* handle, heif_colorspace colorspace,
+                       heif_chroma chroma, const heif_decoding_options* opts = nullptr) const;
+
+    // check_error for the decode result; a canceled decode raises the canceled HeifError and
+    // an exception from the progress callback is re-raised as is. img is the decode output,
+    // released when a callback error is raised even though the decode itself succeeded.
+    void check(const heif_error& err, heif_image* img = nullptr) const;
+
+   private:
+    std::unique_ptr<heif_decoding_options, void (*)(heif_decoding_options*)> options;
+    const CancelToken* cancel;
+    const py::object* progress = nullptr;
+    int max_progress[2] = {0, 0};
+    std::exception_ptr progress_error;
+    std::atomic<bool> progress_failed{false};
+
+    // Negative value/max_value mean "the step's maximum" and "unchanged"
+    void report(heif_progress_step step, int value, int max_value);
+    static void start_progress(heif_progress_step step, int max_progress, void* user_data);
+    static void on_progress(heif_progress_step step, int progress, void* user_data);
+    static void end_progress(heif_progress_step step, void* user_data);
+    static int cancel_decoding(void* user_data);
+};
+
+}  // namespace pylibheif
@@ -0,0 +1,271 @@
+#include "dlpack.hpp"
+
+#include <cstring>
+#include <string>
+
+#include <pybind11/stl.h>
+
+namespace pylibheif {
+
+TensorView plane_view(const std::shared_ptr<HeifImage>& image, heif_channel channel,
+                      bool writeable, bool chw) {
+    py::buffer_info info = image->get_buffer_info(channel, writeable);
+    const PlaneLayout& layout = image->plane_layout(channel);
+
+    TensorView view;
+    view.owner = image;
+    view.data = static_cast<uint8_t*>(info.ptr);
+    view.shape.assign(info.shape.begin(), info.shape.end());
+    view.strides.assign(info.strides.begin(), info.strides.end());
+    view.bytes_per_channel = layout.bytes_per_channel;
+    view.byte_order = layout.byte_order;
+    view.readonly = !writeable;
+    if (chw) {
+        if (view.shape.size() == 2) {
+            // Single channel: a leading axis of one
+            view.shape.insert(view.shape.begin(), 1);
+            view.strides.insert(view.strides.begin(), view.strides[0] * view.shape[1]);
+        } else {
+            // (H, W, C) -> (C, H, W) by permuting the strides; no data moves
+            view.shape = {view.shape[2], view.shape[0], view.shape[1]};
+            view.strides = {view.strides[2], view.strides[0], view.strides[1]};
+        }
+    }
+    return view;
+}
+
+static heif_channel default_channel(const HeifImage& image) {
+    if (heif_image_has_channel(image.get(), heif_channel_interleaved)) {
+        return heif_channel_interleaved;
+    }
+    if (heif_image_get_chroma_format(image.get()) != heif_chroma_monochrome) {
+        throw std::invalid_argument("Planar images have no single array view; use get_plane()");
+    }
+    return heif_channel_Y;
+}
+
+TensorView image_view(const std::shared_ptr<HeifImage>& image) {
+    return plane_view(image, default_channel(*image), true);
+}
+
+TensorView chw_view(const std::shared_ptr<HeifImage>& image) {
+    const heif_image* img = image->get();
+    if (heif_image_has_channel(img, heif_channel_interleaved)) {
+        return plane_view(image, heif_channel_interleaved, true, true);
+    }
+
+    std::vector<heif_channel> channels;
+    if (heif_image_get_colorspace(img) == heif_colorspace_RGB) {
+        channels = {heif_channel_R, heif_channel_G, heif_channel_B};
+    } else if (heif_image_get_chroma_format(img) == heif_chroma_monochrome) {
+        channels = {heif_channel_Y};
+    } else {
+        channels = {heif_channel_Y, heif_channel_Cb, heif_channel_Cr};
+    }
+    if (heif_image_has_channel(img, heif_channel_Alpha)) {
+        channels.push_back(heif_channel_Alpha);
+    }
+
+    const PlaneLayout& first = image->plane_layout(channels[0]);
+    for (heif_channel channel : channels) {
+        const PlaneLayout& layout = image->plane_layout(channel);
+        if (layout.width != first.width || layout.height != first.height ||
+            layout.bytes_per_channel != first.bytes_per_channel) {
+            throw std::invalid_argument(
+                "Planes differ in size or depth (subsampled chroma); decode with "
+                "HeifChroma.C444 or an interleaved chroma for a CHW export");
+        }
+    }
+
+    const size_t row_bytes = static_cast<size_t>(first.width) * first.bytes_per_channel;
+    const size_t plane_bytes = row_bytes * first.height;
+    auto storage = std::make_shared<std::vector<uint8_t>>(plane_bytes * channels.size());
+    {
+        py::gil_scoped_release release;
+        for (size_t c = 0; c < channels.size(); ++c) {
+            int stride;
+            const uint8_t* src = heif_image_get_plane_readonly(img, channels[c], &stride);
+            uint8_t* dst = storage->data() + c * plane_bytes;
+            for (int y = 0; y < first.height; ++y) {
+                std::memcpy(dst + y * row_bytes, src + static_cast<size_t>(y) * stride,
+                            row_bytes);
+            }
+        }
+    }
+
+    TensorView view;
+    view.data = storage->data();
+    view.owner = std::move(storage);
+    view.shape = {static_cast<int64_t>(channels.size()), first.height, first.width};
+    view.strides = {static_cast<int64_t>(plane_bytes), static_cast<int64_t>(row_bytes),
+                    first.bytes_per_channel};
+    view.bytes_per_channel = first.bytes_per_channel;
+    view.copied = true;
+    return view;
+}
+
+// Contiguous copy of a view, for copy=True
+static TensorView copy_view(const TensorView& view) {
+    int64_t count = 1;
+    for (int64_t dim : view.shape) {
+        count *= dim;
+    }
+    const size_t item = view.bytes_per_channel;
+    auto storage = std::make_shared<std::vector<uint8_t>>(static_cast<size_t>(count) * item);
+
+    TensorView copy = view;
+    copy.data = storage->data();
+    int64_t stride = item;
+    for (size_t i = view.shape.size(); i-- > 0;) {
+        copy.strides[i] = stride;
+        stride *= view.shape[i];
+    }
+    {
+        py::gil_scoped_release release;
+        // Walk the source in C order with an index per dimension
+        std::vector<int64_t> index(view.shape.size(), 0);
+        uint8_t* dst = storage->data();
+        for (int64_t n = 0; n < count; ++n) {
+            int64_t offset = 0;
+            for (size_t d = 0; d < index.size(); ++d) {
+                offset += index[d] * view.strides[d];
+            }
+            std::memcpy(dst + n * item, view.data + offset, item);
+            for (size_t d = index.size(); d-- > 0;) {
+                if (++index[d] < view.shape[d]) {
+                    break;
+                }
+                index[d] = 0;
+            }
+        }
+    }
+    copy.owner = std::move(storage);
+    copy.readonly = false;
+    copy.copied = true;
+    return copy;
+}
+
+// Keeps the memory and the shape/stride arrays alive until the consumer calls the deleter,
+// which may happen on any thread and without the GIL
+struct DLPackContext {
+    std::shared_ptr<const void> owner;
+    std::vector<int64_t> shape;
+    std::vector<int64_t> strides;
+    DLManagedTensor legacy;
+    DLManagedTensorVersioned versioned;
+};
+
+static void delete_legacy(DLManagedTensor* self) {
+    delete static_cast<DLPackContext*>(self->manager_ctx);
+}
+
+static void delete_versioned(DLManagedTensorVersioned* self) {
+    delete static_cast<DLPackContext*>(self->manager_ctx);
+}
+
+// A capsule that was never consumed still owns its tensor
+static void legacy_capsule_destructor(PyObject* capsule) {
+    if (PyCapsule_IsValid(capsule, "dltensor")) {
+        auto* tensor = static_cast<DLManagedTensor*>(PyCapsule_GetPointer(capsule, "dltensor"));
+        tensor->deleter(tensor);
+    }
+}
+
+static void versioned_capsule_destructor(PyObject* capsule) {
+    if (PyCapsule_IsValid(capsule, "dltensor_versioned")) {
+        auto* tensor = static_cast<DLManagedTensorVersioned*>(
+            PyCapsule_GetPointer(capsule, "dltensor_versioned"));
+        tensor->deleter(tensor);
+    }
+}
+
+py::tuple dlpack_device() { return py::make_tuple(static_cast<int>(kDLCPU), 0); }
+
+py::capsule to_dlpack(const TensorView& source, const py::object& stream,
+                      const py::object& max_version, const py::object& dl_device,
+                      const py::object& copy) {
+    // CPU data needs no stream synchronization; -1 is the array API's "no sync" value
+    if (!stream.is_none() && !(py::isinstance<py::int_>(stream) && stream.cast<int>() == -1)) {
+        throw py::buffer_error("stream must be None for CPU tensors");
+    }
+    if (!dl_device.is_none() && !dl_device.equal(dlpack_device())) {
+        throw py::buffer_error("Images can only be exported to the CPU device");
+    }
+    if (!copy.is_none() && !copy.cast<bool>() && source.copied) {
+        throw py::buffer_error("This view needs a copy (planar CHW); pass copy=None or True");
+    }
+    if (source.byte_order != ByteOrder::Native) {
+        throw py::buffer_error("DLPack has no byte order; decode 16-bit images in host order");
+    }
+    const bool make_copy = !copy.is_none() && copy.cast<bool>() && !source.copied;
+    const TensorView view = make_copy ? copy_view(source) : source;
+
+    const int64_t item = view.bytes_per_channel;
+    auto ctx = std::make_unique<DLPackContext>();
+    ctx->owner = view.owner;
+    ctx->shape = view.shape;
+    for (int64_t stride : view.strides) {
+        if (stride % item != 0) {
+            throw py::buffer_error("Plane stride is not a multiple of the sample size");
+        }
+        ctx->strides.push_back(stride / item);
+    }
+
+    DLTensor tensor;
+    tensor.data = view.data;
+    tensor.device = {kDLCPU, 0};
+    tensor.ndim = static_cast<int32_t>(view.shape.size());
+    tensor.dtype = {kDLUInt, static_cast<uint8_t>(item * 8), 1};
+    tensor.shape = ctx->shape.data();
+    tensor.strides = ctx->strides.data();
+    tensor.byte_offset = 0;
+
+    bool versioned = false;
+    if (!max_version.is_none()) {
+        py::tuple version = max_version.cast<py::tuple>();
+        versioned = version.size() >= 1 && version[0].cast<int>() >= 1;
+    }
+    PyObject* capsule;
+    if (versioned) {
+        DLManagedTensorVersioned* managed = &ctx->versioned;
+        managed->version = {1, 0};
+        managed->manager_ctx = ctx.get();
+        managed->deleter = delete_versioned;
+        managed->flags = (view.readonly ? kDLPackFlagReadOnly : 0) |
+                         (view.copied ? kDLPackFlagIsCopied : 0);
+        managed->dl_tensor = tensor;
+        capsule = PyCapsule_New(managed, "dltensor_versioned", versioned_capsule_destructor);
+    } else {
+        DLManagedTensor* managed = &ctx->legacy;
+        managed->dl_tensor = tensor;
+        managed->manager_ctx = ctx.get();
+        managed->deleter = delete_legacy;
+        capsule = PyCapsule_New(managed, "dltensor", legacy_capsule_destructor);
+    }
+    if (!capsule) {
+        throw py::error_already_set();
+    }
+    ctx.release();  // Now owned by the capsule, then by the consumer
+    return py::reinterpret_steal<py::capsule>(capsule);
+}
+
+py::dict array_interface(const TensorView& view) {
+    std::string typestr = "|u1";
+    if (view.bytes_per_channel == 2) {
+        ByteOrder order = view.byte_order;
+        if (order == ByteOrder::Native) {
+            order = host_is_little_endian() ? ByteOrder::Little : ByteOrder::Big;
+        }
+        typestr = order == ByteOrder::Little ? "<u2" : ">u2";
+    }
+
+    py::dict interface;
+    interface["version"] = 3;
+    interface["typestr"] = typestr;
+    interface["shape"] = py::tuple(py::cast(view.shape));
+    interface["strides"] = py::tuple(py::cast(view.strides));
+    interface["data"] = py::make_tuple(reinterpret_cast<uintptr_t>(view.data), view.readonly);
+    return interface;
+}
+
+}  // namespace pylibheif
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "common.hpp"
+#include "image.hpp"
+
+namespace pylibheif {
+
+// Minimal DLPack ABI (dlpack.h 1.0, including the pre-1.0 unversioned tensor still used by
+// older consumers). Only what the CPU exports below need.
+enum DLDeviceType : int32_t { kDLCPU = 1 };
+enum DLDataTypeCode : uint8_t { kDLUInt = 1 };
+
+struct DLDevice {
+    int32_t device_type;
+    int32_t device_id;
+};
+
+struct DLDataType {
+    uint8_t code;
+    uint8_t bits;
+    uint16_t lanes;
+};
+
+struct DLTensor {
+    void* data;
+    DLDevice device;
+    int32_t ndim;
+    DLDataType dtype;
+    int64_t* shape;
+    int64_t* strides;  // In elements
+    uint64_t byte_offset;
+};
+
+struct DLManagedTensor {
+    DLTensor dl_tensor;
+    void* manager_ctx;
+    void (*deleter)(DLManagedTensor* self);
+};
+
+struct DLPackVersion {
+    uint32_t major;
+    uint32_t minor;
+};
+
+constexpr uint64_t kDLPackFlagReadOnly = 1ull << 0;
+constexpr uint64_t kDLPackFlagIsCopied = 1ull << 1;
+
+struct DLManagedTensorVersioned {
+    DLPackVersion version;
+    void* manager_ctx;
+    void (*deleter)(DLManagedTensorVersioned* self);
+    uint64_t flags;
+    DLTensor dl_tensor;
+};
+
+// Strided view of image samples shared by the DLPack and __array_interface__ exports. The
+// owner keeps the memory alive: the heif_image itself, or a copy made for the view.
+struct TensorView {
+    std::shared_ptr<const void> owner;
+    uint8_t* data = nullptr;
+    std::vector<int64_t> shape;
+    std::vector<int64_t> strides;  // In bytes
+    int bytes_per_channel = 1;
+    ByteOrder byte_order = ByteOrder::Native;
+    bool readonly = false;
+    bool copied = false;
+};
+
+// One plane as (height, width[, channels]), or as (channels, height, width) when chw
+TensorView plane_view(const std::shared_ptr<HeifImage>& image, heif_channel channel,
+                      bool writeable, bool chw = false);
+// Interleaved pixels, or the Y plane of a monochrome image, as returned by as_array
+TensorView image_view(const std::shared_ptr<HeifImage>& image);
+// Every color plane plus alpha as (channels, height, width). A strided view of interleaved
+// images; planar images with equally sized planes are copied once into one tensor.
+TensorView chw_view(const std::shared_ptr<HeifImage>& image);
+
+// __dlpack__ of the array API standard: a "dltensor_versioned" capsule when the consumer
+// accepts DLPack >= 1.0, else a legacy "dltensor" capsule. copy=True exports a copy.
+py::capsule to_dlpack(const TensorView& view, const py::object& stream,
+                      const py::object& max_version, const py::object& dl_device,
+                      const py::object& copy);
+py::tuple dlpack_device();
+// numpy __array_interface__ (version 3)
+py::dict array_interface(const TensorView& view);
+
+}  // namespace pylibheif
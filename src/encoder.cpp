@@ -1,7 +1,9 @@
 #include "encoder.hpp"
 
+#include "cancel.hpp"
 #include "context.hpp"
 #include "image.hpp"
+#include "stats.hpp"
 
 namespace pylibheif {
 
@@ -29,14 +31,161 @@ void HeifEncoder::set_parameter(const std::string& name, const std::string& valu
     check_error(heif_encoder_set_parameter(encoder, name.c_str(), value.c_str()));
 }
 
+std::vector<std::string> HeifEncoder::list_parameters() const {
+    std::vector<std::string> names;
+    for (const heif_encoder_parameter* const* param = heif_encoder_list_parameters(encoder);
+         param && *param; ++param) {
+        names.emplace_back(heif_encoder_parameter_get_name(*param));
+    }
+    return names;
+}
+
+bool HeifEncoder::has_parameter(const std::string& name) const {
+    for (const heif_encoder_parameter* const* param = heif_encoder_list_parameters(encoder);
+         param && *param; ++param) {
+        if (name == heif_encoder_parameter_get_name(*param)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void HeifEncoder::set_threads(int count) {
+    if (count < 1) {
+        throw std::invalid_argument("threads must be >= 1");
+    }
+
+    if (has_parameter("threads")) {
+        // aom, rav1e, SVT-AV1 and OpenJPEG expose a native parameter
+        check_error(heif_encoder_set_parameter_integer(encoder, "threads", count));
+    } else if (name().find("x265") != std::string::npos) {
+        // x265 sizes its worker pool via the pass-through "x265:<option>" parameters
+        set_parameter("x265:pools", std::to_string(count));
+        set_parameter("x265:frame-threads", "1");
+    } else {
+        heif_error err = {heif_error_Usage_error, heif_suberror_Unsupported_parameter,
+                          "This encoder has no thread count parameter"};
+        throw HeifError(err);
+    }
+    threads = count;
+}
+
 std::shared_ptr<HeifImageHandle> HeifEncoder::encode_image(HeifContext& ctx, const HeifImage& image,
-                                                           std::string preset) {
+                                                           std::string preset,
+                                                           const EncodingOptions* options,
+                                                           const CancelToken* cancel) {
     if (!preset.empty()) {
         set_parameter("preset", preset);
     }
+    return std::make_shared<HeifImageHandle>(encode(ctx.get(), image, options, cancel));
+}
+
+heif_image_handle* HeifEncoder::encode(heif_context* ctx, const HeifImage& image,
+                                       const EncodingOptions* options,
+                                       const CancelToken* cancel) {
+    check_canceled(cancel);
+    ScopedTimer timer(Stage::Encode);
+    const heif_encoding_options* opts = options ? options->get() : nullptr;
+
     heif_image_handle* handle;
-    check_error(heif_context_encode_image(ctx.get(), image.get(), encoder, nullptr, &handle));
-    return std::make_shared<HeifImageHandle>(handle);
+    check_error(heif_context_encode_image(ctx, image.get(), encoder, opts, &handle));
+
+    if (options && options->get_thumbnail_size() > 0) {
+        heif_image_handle* thumbnail = nullptr;
+        heif_error err = heif_context_encode_thumbnail(ctx, image.get(), handle, encoder, opts,
+                                                       options->get_thumbnail_size(), &thumbnail);
+        if (err.code != heif_error_Ok) {
+            heif_image_handle_release(handle);
+            check_error(err);
+        }
+        // No thumbnail is created when the image already fits into the bounding box
+        if (thumbnail) {
+            heif_image_handle_release(thumbnail);
+        }
+    }
+    if (timer.enabled()) {
+        // Bytes are the uncompressed input; the compressed size is known once serialized
+        timer.add_bytes(image_bytes(image.get()));
+        record_plugin("encoder", heif_encoder_get_name(encoder));
+    }
+    return handle;
+}
+
+// EncodingOptions
+EncodingOptions::EncodingOptions() : options(heif_encoding_options_alloc()) {}
+
+EncodingOptions::~EncodingOptions() {
+    if (options) {
+        heif_encoding_options_free(options);
+    }
+    if (nclx) {
+        heif_nclx_color_profile_free(nclx);
+    }
+}
+
+bool EncodingOptions::get_save_alpha_channel() const { return options->save_alpha_channel != 0; }
+
+void EncodingOptions::set_save_alpha_channel(bool value) {
+    options->save_alpha_channel = value ? 1 : 0;
+}
+
+heif_orientation EncodingOptions::get_image_orientation() const {
+    return options->image_orientation;
+}
+
+void EncodingOptions::set_image_orientation(heif_orientation orientation) {
+    options->image_orientation = orientation;
+}
+
+heif_chroma_downsampling_algorithm EncodingOptions::get_chroma_downsampling() const {
+    return options->color_conversion_options.preferred_chroma_downsampling_algorithm;
+}
+
+void EncodingOptions::set_chroma_downsampling(heif_chroma_downsampling_algorithm algorithm) {
+    options->color_conversion_options.preferred_chroma_downsampling_algorithm = algorithm;
+}
+
+bool EncodingOptions::get_only_use_preferred_chroma_algorithm() const {
+    return options->color_conversion_options.only_use_preferred_chroma_algorithm != 0;
+}
+
+void EncodingOptions::set_only_use_preferred_chroma_algorithm(bool value) {
+    options->color_conversion_options.only_use_preferred_chroma_algorithm = value ? 1 : 0;
+}
+
+std::optional<NclxColorProfile> EncodingOptions::get_output_nclx_profile() const {
+    if (!nclx) {
+        return std::nullopt;
+    }
+    return nclx_from_heif(nclx);
+}
+
+void EncodingOptions::set_output_nclx_profile(const std::optional<NclxColorProfile>& profile) {
+    if (!profile) {
+        options->output_nclx_profile = nullptr;
+        if (nclx) {
+            heif_nclx_color_profile_free(nclx);
+            nclx = nullptr;
+        }
+        return;
+    }
+    if (!nclx) {
+        nclx = heif_nclx_color_profile_alloc();
+    }
+    check_error(heif_nclx_color_profile_set_color_primaries(nclx, profile->color_primaries));
+    check_error(heif_nclx_color_profile_set_transfer_characteristics(
+        nclx, profile->transfer_characteristics));
+    check_error(
+        heif_nclx_color_profile_set_matrix_coefficients(nclx, profile->matrix_coefficients));
+    nclx->full_range_flag = profile->full_range ? 1 : 0;
+    options->output_nclx_profile = nclx;
+}
+
+void EncodingOptions::set_thumbnail_size(int size) {
+    if (size < 0) {
+        throw std::invalid_argument("thumbnail_size must be >= 0");
+    }
+    thumbnail_size = size;
 }
 
 // HeifEncoderDescriptor
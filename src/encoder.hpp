@@ -1,5 +1,6 @@
 #pragma once
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -7,6 +8,7 @@
 
 namespace pylibheif {
 
+class CancelToken;
 class HeifContext;
 class HeifImage;
 class HeifImageHandle;
@@ -29,24 +31,82 @@ std::vector<HeifEncoderDescriptor> get_encoder_descriptors(
     heif_compression_format format_filter = heif_compression_undefined,
     const std::string& name_filter = "");
 
+// Reusable set of heif_encoding_options
+class EncodingOptions {
+   public:
+    EncodingOptions();
+    ~EncodingOptions();
+
+    EncodingOptions(const EncodingOptions&) = delete;
+    EncodingOptions& operator=(const EncodingOptions&) = delete;
+
+    bool get_save_alpha_channel() const;
+    void set_save_alpha_channel(bool value);
+
+    heif_orientation get_image_orientation() const;
+    void set_image_orientation(heif_orientation orientation);
+
+    heif_chroma_downsampling_algorithm get_chroma_downsampling() const;
+    void set_chroma_downsampling(heif_chroma_downsampling_algorithm algorithm);
+
+    bool get_only_use_preferred_chroma_algorithm() const;
+    void set_only_use_preferred_chroma_algorithm(bool value);
+
+    // nullopt writes the profile attached to the image (or libheif's default)
+    std::optional<NclxColorProfile> get_output_nclx_profile() const;
+    void set_output_nclx_profile(const std::optional<NclxColorProfile>& profile);
+
+    // Bounding box of a thumbnail encoded alongside the image (0 = no thumbnail)
+    int get_thumbnail_size() const { return thumbnail_size; }
+    void set_thumbnail_size(int size);
+
+    const heif_encoding_options* get() const { return options; }
+
+   private:
+    heif_encoding_options* options;
+    heif_color_profile_nclx* nclx = nullptr;
+    int thumbnail_size = 0;
+};
+
 class HeifEncoder {
    public:
     HeifEncoder(heif_compression_format format);
     HeifEncoder(const HeifEncoderDescriptor& descriptor);
     ~HeifEncoder();
 
+    HeifEncoder(const HeifEncoder&) = delete;
+    HeifEncoder& operator=(const HeifEncoder&) = delete;
+
     std::string name() const;
 
     void set_lossy_quality(int quality);
     void set_parameter(const std::string& name, const std::string& value);
+    std::vector<std::string> list_parameters() const;
+
+    // Worker threads used by the codec, mapped to the backend's own parameter. Reads 0 (the
+    // encoder default) until set; set_threads requires >= 1.
+    int get_threads() const { return threads; }
+    void set_threads(int count);
 
+    // libheif cannot interrupt a running encode, so `cancel` is checked before it starts
     std::shared_ptr<HeifImageHandle> encode_image(HeifContext& ctx, const HeifImage& image,
-                                                  std::string preset = "");
+                                                  std::string preset = "",
+                                                  const EncodingOptions* options = nullptr,
+                                                  const CancelToken* cancel = nullptr);
+
+    // Encodes into a raw context and returns the owned handle. Touches no Python state, so
+    // it can run on native worker threads.
+    heif_image_handle* encode(heif_context* ctx, const HeifImage& image,
+                              const EncodingOptions* options = nullptr,
+                              const CancelToken* cancel = nullptr);
 
     heif_encoder* get() { return encoder; }
 
    private:
+    bool has_parameter(const std::string& name) const;
+
     heif_encoder* encoder;
+    int threads = 0;
 };
 
 }  // namespace pylibheif
@@ -1,7 +1,136 @@
 #include "image.hpp"
 
+#include <algorithm>
+#include <cstring>
+
+#include "budget.hpp"
+#include "decoder.hpp"
+#include "pool.hpp"
+#include "resize.hpp"
+#include "stats.hpp"
+
 namespace pylibheif {
 
+PlaneLayout describe_plane(const heif_image* img, heif_channel channel) {
+    PlaneLayout layout;
+    layout.width = heif_image_get_width(img, channel);
+    layout.height = heif_image_get_height(img, channel);
+    layout.bits = heif_image_get_bits_per_pixel_range(img, channel);
+    layout.bytes_per_channel = (layout.bits + 7) / 8;
+    if (channel != heif_channel_interleaved) {
+        return layout;
+    }
+
+    const heif_chroma chroma = heif_image_get_chroma_format(img);
+    switch (chroma) {
+        case heif_chroma_interleaved_RGB:
+            layout.channels = 3;
+            break;
+        case heif_chroma_interleaved_RGBA:
+            layout.channels = 4;
+            break;
+        case heif_chroma_interleaved_RRGGBB_BE:
+        case heif_chroma_interleaved_RRGGBB_LE:
+            layout.channels = 3;
+            layout.bytes_per_channel = 2;
+            break;
+        case heif_chroma_interleaved_RRGGBBAA_BE:
+        case heif_chroma_interleaved_RRGGBBAA_LE:
+            layout.channels = 4;
+            layout.bytes_per_channel = 2;
+            break;
+        default:
+            break;
+    }
+    // 16-bit interleaved samples have a fixed byte order, which may differ from the host's
+    if (layout.bytes_per_channel == 2 && chroma != native_hdr_chroma(false) &&
+        chroma != native_hdr_chroma(true)) {
+        layout.byte_order = host_is_little_endian() ? ByteOrder::Big : ByteOrder::Little;
+    }
+    return layout;
+}
+
+std::string PlaneLayout::format() const {
+    if (bytes_per_channel == 1) {
+        return py::format_descriptor<uint8_t>::format();
+    }
+    switch (byte_order) {
+        case ByteOrder::Big:
+            return ">H";
+        case ByteOrder::Little:
+            return "<H";
+        default:
+            return py::format_descriptor<uint16_t>::format();
+    }
+}
+
+// Byte strides of an interleaved pixel buffer
+struct PixelLayout {
+    py::ssize_t row;
+    py::ssize_t pixel;
+    py::ssize_t channel;
+};
+
+// Copies width x height pixels between two strided buffers. Packed rows on both sides
+// (the common case) are copied with one memcpy per row.
+static void copy_pixels(const uint8_t* src, const PixelLayout& src_layout, uint8_t* dst,
+                        const PixelLayout& dst_layout, py::ssize_t width, py::ssize_t height,
+                        py::ssize_t channels, py::ssize_t bytes_per_channel) {
+    const py::ssize_t packed_pixel = channels * bytes_per_channel;
+    auto packed = [&](const PixelLayout& l) {
+        return l.channel == bytes_per_channel && l.pixel == packed_pixel;
+    };
+
+    if (packed(src_layout) && packed(dst_layout)) {
+        const size_t row_bytes = static_cast<size_t>(width * packed_pixel);
+        for (py::ssize_t y = 0; y < height; ++y) {
+            memcpy(dst + y * dst_layout.row, src + y * src_layout.row, row_bytes);
+        }
+        return;
+    }
+
+    for (py::ssize_t y = 0; y < height; ++y) {
+        const uint8_t* s_row = src + y * src_layout.row;
+        uint8_t* d_row = dst + y * dst_layout.row;
+        for (py::ssize_t x = 0; x < width; ++x) {
+            const uint8_t* s = s_row + x * src_layout.pixel;
+            uint8_t* d = d_row + x * dst_layout.pixel;
+            for (py::ssize_t c = 0; c < channels; ++c) {
+                memcpy(d + c * dst_layout.channel, s + c * src_layout.channel, bytes_per_channel);
+            }
+        }
+    }
+}
+
+// Whether a buffer format ("B", "<H", ...) holds unsigned integers; parsed by hand so that
+// it can be checked without the GIL
+static bool unsigned_integer_format(const std::string& format) {
+    size_t i = 0;
+    while (i < format.size() && std::strchr("@=<>!", format[i])) {
+        ++i;
+    }
+    return format.size() == i + 1 && std::strchr("BHILQN", format[i]);
+}
+
+void copy_color_profiles(const heif_image* src, heif_image* dst) {
+    heif_color_profile_nclx* nclx = nullptr;
+    if (heif_image_get_nclx_color_profile(src, &nclx).code == heif_error_Ok && nclx) {
+        heif_image_set_nclx_color_profile(dst, nclx);
+        heif_nclx_color_profile_free(nclx);
+    }
+
+    size_t icc_size = heif_image_get_raw_color_profile_size(src);
+    if (icc_size > 0) {
+        std::vector<uint8_t> icc(icc_size);
+        const char* type =
+            heif_image_get_color_profile_type(src) == heif_color_profile_type_rICC ? "rICC"
+                                                                                   : "prof";
+        if (heif_image_get_raw_color_profile(src, icc.data()).code == heif_error_Ok) {
+            heif_image_set_raw_color_profile(dst, type, icc.data(), icc.size());
+        }
+    }
+}
+
 HeifImageHandle::~HeifImageHandle() {
     if (handle) {
         heif_image_handle_release(handle);
@@ -24,12 +153,357 @@ int HeifImageHandle::get_chroma_bits_per_pixel() const {
     return heif_image_handle_get_chroma_bits_per_pixel(handle);
 }
 
-std::shared_ptr<HeifImage> HeifImageHandle::decode(heif_colorspace colorspace, heif_chroma chroma) {
-    heif_image* img;
-    check_error(heif_decode_image(handle, &img, colorspace, chroma, nullptr));
+std::shared_ptr<HeifImage> HeifImageHandle::decode(heif_colorspace colorspace, heif_chroma chroma,
+                                                   const DecodingOptions* options, int max_width,
+                                                   int max_height, const CancelToken* cancel,
+                                                   MemoryBudget* budget) {
+    if (max_width < 0 || max_height < 0) {
+        throw std::invalid_argument("max_width and max_height must be >= 0");
+    }
+    BudgetLease lease(budget, budget ? estimate_decode_bytes(colorspace, chroma) : 0, cancel);
+    DecodeCall call(options, cancel);
+    heif_image* img = call.decode(handle, colorspace, chroma);
+    auto image = std::make_shared<HeifImage>(img);
+
+    const int width = heif_image_get_primary_width(img);
+    const int height = heif_image_get_primary_height(img);
+    int target_width, target_height;
+    fit_within(width, height, max_width, max_height, target_width, target_height);
+    if (target_width != width || target_height != height) {
+        // The full-size image is released as soon as the preview exists
+        image =
+            std::make_shared<HeifImage>(downscale_image(img, target_width, target_height), true);
+    }
+    return image;
+}
+
+std::shared_ptr<HeifImage> HeifImageHandle::decode_hdr(std::optional<bool> alpha,
+                                                       const DecodingOptions* options,
+                                                       const CancelToken* cancel) {
+    // Start from the caller's options but never let libheif reduce to 8 bits
+    DecodeCall call(options, cancel);
+    heif_decoding_options opts = *call.get();
+    opts.convert_hdr_to_8bit = 0;
+
+    const bool with_alpha = alpha.value_or(has_alpha_channel());
+    heif_image* img =
+        call.decode(handle, heif_colorspace_RGB, native_hdr_chroma(with_alpha), &opts);
+    return std::make_shared<HeifImage>(img);
+}
+
+std::optional<NclxColorProfile> HeifImageHandle::get_nclx_color_profile() const {
+    heif_color_profile_nclx* nclx = nullptr;
+    if (heif_image_handle_get_nclx_color_profile(handle, &nclx).code != heif_error_Ok || !nclx) {
+        return std::nullopt;
+    }
+    NclxColorProfile profile = nclx_from_heif(nclx);
+    heif_nclx_color_profile_free(nclx);
+    return profile;
+}
+
+ImageTiling HeifImageHandle::get_tiling(bool process_transformations) const {
+    heif_image_tiling tiling;
+    check_error(heif_image_handle_get_image_tiling(handle, process_transformations ? 1 : 0,
+                                                   &tiling));
+    ImageTiling result;
+    result.num_columns = tiling.num_columns;
+    result.num_rows = tiling.num_rows;
+    result.tile_width = tiling.tile_width;
+    result.tile_height = tiling.tile_height;
+    result.image_width = tiling.image_width;
+    result.image_height = tiling.image_height;
+    result.top_offset = tiling.top_offset;
+    result.left_offset = tiling.left_offset;
+    return result;
+}
+
+std::shared_ptr<HeifImage> HeifImageHandle::decode_tile(uint32_t tile_x, uint32_t tile_y,
+                                                        heif_colorspace colorspace,
+                                                        heif_chroma chroma,
+                                                        const DecodingOptions* options,
+                                                        const CancelToken* cancel) {
+    ScopedTimer timer(Stage::Decode);
+    DecodeCall call(options, cancel);
+    heif_image* img = nullptr;
+    const heif_error err = heif_image_handle_decode_image_tile(handle, &img, colorspace, chroma,
+                                                               call.get(), tile_x, tile_y);
+    call.check(err, img);
+    if (timer.enabled()) {
+        timer.add_bytes(image_bytes(img));
+    }
     return std::make_shared<HeifImage>(img);
 }
 
+std::shared_ptr<HeifImage> HeifImageHandle::decode_region(int x, int y, int width, int height,
+                                                          heif_colorspace colorspace,
+                                                          heif_chroma chroma,
+                                                          const DecodingOptions* options,
+                                                          const CancelToken* cancel) {
+    bool transform = !(options && options->get_ignore_transformations());
+    ImageTiling tiling = get_tiling(transform);
+
+    if (width <= 0 || height <= 0 || x < 0 || y < 0 ||
+        static_cast<int64_t>(x) + width > tiling.image_width ||
+        static_cast<int64_t>(y) + height > tiling.image_height) {
+        throw std::out_of_range("Region lies outside the image");
+    }
+
+    // Tile (col,row) covers image pixels starting at col * tile_width - left_offset
+    const int64_t tw = tiling.tile_width;
+    const int64_t th = tiling.tile_height;
+    const int64_t first_col = (x + tiling.left_offset) / tw;
+    const int64_t last_col = (x + width - 1 + tiling.left_offset) / tw;
+    const int64_t first_row = (y + tiling.top_offset) / th;
+    const int64_t last_row = (y + height - 1 + tiling.top_offset) / th;
+
+    // Subsampled chroma needs the region and every tile origin on the chroma grid. An odd
+    // extent is fine where the region ends at the image edge, since the last chroma sample
+    // covers the leftover column / row there.
+    heif_chroma decoded_chroma = chroma;
+    if (decoded_chroma == heif_chroma_undefined) {
+        heif_colorspace native_colorspace;
+        heif_image_handle_get_preferred_decoding_colorspace(handle, &native_colorspace,
+                                                            &decoded_chroma);
+    }
+    const int64_t cx =
+        (decoded_chroma == heif_chroma_420 || decoded_chroma == heif_chroma_422) ? 2 : 1;
+    const int64_t cy = decoded_chroma == heif_chroma_420 ? 2 : 1;
+    const int64_t first_x0 = first_col * tw - tiling.left_offset;
+    const int64_t first_y0 = first_row * th - tiling.top_offset;
+    if (x % cx || (width % cx && int64_t(x) + width != tiling.image_width) || first_x0 % cx ||
+        (last_col > first_col && tw % cx) || y % cy ||
+        (height % cy && int64_t(y) + height != tiling.image_height) || first_y0 % cy ||
+        (last_row > first_row && th % cy)) {
+        throw std::invalid_argument(
+            "Region must be aligned to the chroma subsampling of the requested chroma format");
+    }
+
+    heif_image* out = nullptr;
+    std::shared_ptr<HeifImage> result;
+
+    for (int64_t row = first_row; row <= last_row; ++row) {
+        for (int64_t col = first_col; col <= last_col; ++col) {
+            auto tile = decode_tile(static_cast<uint32_t>(col), static_cast<uint32_t>(row),
+                                    colorspace, chroma, options, cancel);
+            const heif_image* src = tile->get();
+            const int64_t tile_x0 = col * tw - tiling.left_offset;
+            const int64_t tile_y0 = row * th - tiling.top_offset;
+            const int src_w = heif_image_get_primary_width(src);
+            const int src_h = heif_image_get_primary_height(src);
+
+            // Intersection of region and tile, in image coordinates
+            const int64_t ix0 = std::max<int64_t>(x, tile_x0);
+            const int64_t iy0 = std::max<int64_t>(y, tile_y0);
+            const int64_t ix1 = std::min<int64_t>(x + width, tile_x0 + src_w);
+            const int64_t iy1 = std::min<int64_t>(y + height, tile_y0 + src_h);
+            if (ix0 >= ix1 || iy0 >= iy1) {
+                continue;
+            }
+
+            // Chroma planes may be subsampled relative to the tile
+            auto subsampling = [&](heif_channel channel, int& sx, int& sy) {
+                const int plane_w = std::max(1, heif_image_get_width(src, channel));
+                const int plane_h = std::max(1, heif_image_get_height(src, channel));
+                sx = (src_w + plane_w - 1) / plane_w;
+                sy = (src_h + plane_h - 1) / plane_h;
+            };
+
+            // The output takes its plane layout from the first decoded tile
+            if (!result) {
+                std::vector<PlaneSpec> planes;
+                for (heif_channel channel : kAllChannels) {
+                    if (heif_image_has_channel(src, channel)) {
+                        int sx, sy;
+                        subsampling(channel, sx, sy);
+                        planes.push_back({channel, (width + sx - 1) / sx, (height + sy - 1) / sy,
+                                          heif_image_get_bits_per_pixel_range(src, channel)});
+                    }
+                }
+                out = acquire_image(width, height, colorspace, chroma, planes,
+                                    color_profile_key(src));
+                result = std::make_shared<HeifImage>(out, true);
+            }
+
+            for (heif_channel channel : kAllChannels) {
+                if (!heif_image_has_channel(src, channel)) {
+                    continue;
+                }
+                int sx, sy;
+                subsampling(channel, sx, sy);
+
+                int src_stride;
+                int dst_stride;
+                const uint8_t* src_data = heif_image_get_plane_readonly(src, channel, &src_stride);
+                uint8_t* dst_data = heif_image_get_plane(out, channel, &dst_stride);
+                const int bpp = describe_plane(src, channel).bytes_per_pixel();
+
+                const size_t row_bytes = static_cast<size_t>((ix1 - ix0 + sx - 1) / sx) * bpp;
+                const int64_t rows = (iy1 - iy0 + sy - 1) / sy;
+                const uint8_t* s = src_data + ((iy0 - tile_y0) / sy) * src_stride +
+                                   ((ix0 - tile_x0) / sx) * bpp;
+                uint8_t* d = dst_data + ((iy0 - y) / sy) * dst_stride + ((ix0 - x) / sx) * bpp;
+                for (int64_t r = 0; r < rows; ++r) {
+                    memcpy(d + r * dst_stride, s + r * src_stride, row_bytes);
+                }
+            }
+
+            if (row == first_row && col == first_col) {
+                copy_color_profiles(src, out);
+            }
+        }
+    }
+    if (!result) {
+        throw std::runtime_error("Region is not covered by any tile");
+    }
+    return result;
+}
+
+void HeifImageHandle::decode_into(const py::buffer& out, heif_colorspace colorspace,
+                                  heif_chroma chroma, const DecodingOptions* options,
+                                  const CancelToken* cancel, MemoryBudget* budget) {
+    py::buffer_info info = out.request(true);
+    if (info.readonly) {
+        throw std::invalid_argument("decode_into requires a writable buffer");
+    }
+
+    py::gil_scoped_release release;
+    auto img = decode(colorspace, chroma, options, 0, 0, cancel, budget);
+    copy_image_into(*img, info);
+}
+
+uint64_t HeifImageHandle::estimate_decode_bytes(heif_colorspace colorspace,
+                                                heif_chroma chroma) const {
+    return pylibheif::estimate_decode_bytes(handle, colorspace, chroma,
+                                            tile_threads ? tile_threads->load() : -1);
+}
+
+int HeifImageHandle::get_number_of_thumbnails() const {
+    return heif_image_handle_get_number_of_thumbnails(handle);
+}
+
+std::vector<heif_item_id> HeifImageHandle::get_list_of_thumbnail_IDs() const {
+    int count = heif_image_handle_get_number_of_thumbnails(handle);
+    std::vector<heif_item_id> ids(count);
+    count = heif_image_handle_get_list_of_thumbnail_IDs(handle, ids.data(), count);
+    ids.resize(count);
+    return ids;
+}
+
+std::shared_ptr<HeifImageHandle> HeifImageHandle::get_thumbnail(heif_item_id id) const {
+    heif_image_handle* thumbnail;
+    check_error(heif_image_handle_get_thumbnail(handle, id, &thumbnail));
+    return std::make_shared<HeifImageHandle>(thumbnail, tile_threads);
+}
+
+std::shared_ptr<HeifImageHandle> HeifImageHandle::get_thumbnail_for_size(int min_width,
+                                                                         int min_height) {
+    std::shared_ptr<HeifImageHandle> best;
+    int64_t best_pixels = 0;
+    for (heif_item_id id : get_list_of_thumbnail_IDs()) {
+        auto thumbnail = get_thumbnail(id);
+        int width = thumbnail->get_width();
+        int height = thumbnail->get_height();
+        if (width < min_width || height < min_height) {
+            continue;
+        }
+        int64_t pixels = static_cast<int64_t>(width) * height;
+        if (!best || pixels < best_pixels) {
+            best = std::move(thumbnail);
+            best_pixels = pixels;
+        }
+    }
+    return best ? best : shared_from_this();
+}
+
+std::vector<heif_item_id> HeifImageHandle::get_list_of_depth_image_IDs() const {
+    int count = heif_image_handle_get_number_of_depth_images(handle);
+    std::vector<heif_item_id> ids(count);
+    count = heif_image_handle_get_list_of_depth_image_IDs(handle, ids.data(), count);
+    ids.resize(count);
+    return ids;
+}
+
+std::shared_ptr<HeifImageHandle> HeifImageHandle::get_depth_image(heif_item_id id) const {
+    heif_image_handle* depth;
+    check_error(heif_image_handle_get_depth_image_handle(handle, id, &depth));
+    return std::make_shared<HeifImageHandle>(depth, tile_threads);
+}
+
+std::optional<DepthRepresentation> HeifImageHandle::get_depth_representation(
+    heif_item_id id) const {
+    const heif_depth_representation_info* info = nullptr;
+    if (!heif_image_handle_get_depth_image_representation_info(handle, id, &info) || !info) {
+        return std::nullopt;
+    }
+    DepthRepresentation result;
+    result.type = info->depth_representation_type;
+    if (info->has_z_near) {
+        result.z_near = info->z_near;
+    }
+    if (info->has_z_far) {
+        result.z_far = info->z_far;
+    }
+    if (info->has_d_min) {
+        result.d_min = info->d_min;
+    }
+    if (info->has_d_max) {
+        result.d_max = info->d_max;
+    }
+    result.disparity_reference_view = info->disparity_reference_view;
+    heif_depth_representation_info_free(info);
+    return result;
+}
+
+std::vector<heif_item_id> HeifImageHandle::get_list_of_auxiliary_image_IDs(
+    bool include_alpha, bool include_depth) const {
+    const int filter = (include_alpha ? 0 : LIBHEIF_AUX_IMAGE_FILTER_OMIT_ALPHA) |
+                       (include_depth ? 0 : LIBHEIF_AUX_IMAGE_FILTER_OMIT_DEPTH);
+    int count = heif_image_handle_get_number_of_auxiliary_images(handle, filter);
+    std::vector<heif_item_id> ids(count);
+    count = heif_image_handle_get_list_of_auxiliary_image_IDs(handle, filter, ids.data(), count);
+    ids.resize(count);
+    return ids;
+}
+
+std::shared_ptr<HeifImageHandle> HeifImageHandle::get_auxiliary_image(heif_item_id id) const {
+    heif_image_handle* aux;
+    check_error(heif_image_handle_get_auxiliary_image_handle(handle, id, &aux));
+    return std::make_shared<HeifImageHandle>(aux, tile_threads);
+}
+
+std::string HeifImageHandle::get_auxiliary_type() const {
+    const char* type = nullptr;
+    if (heif_image_handle_get_auxiliary_type(handle, &type).code != heif_error_Ok || !type) {
+        return "";
+    }
+    std::string result(type);
+    heif_image_handle_release_auxiliary_type(handle, &type);
+    return result;
+}
+
+// Auxiliary types of HDR gain maps stored next to the SDR image
+static const char* const kGainMapTypes[] = {
+    "urn:com:apple:photo:2020:aux:hdrgainmap",
+    "urn:iso:std:iso:ts:21496:-1",
+};
+
+std::shared_ptr<HeifImageHandle> HeifImageHandle::get_gain_map() const {
+    for (heif_item_id id : get_list_of_auxiliary_image_IDs()) {
+        auto aux = get_auxiliary_image(id);
+        const std::string type = aux->get_auxiliary_type();
+        for (const char* gain_map : kGainMapTypes) {
+            if (type == gain_map) {
+                return aux;
+            }
+        }
+    }
+    return nullptr;
+}
+
+bool HeifImageHandle::is_premultiplied_alpha() const {
+    return heif_image_handle_is_premultiplied_alpha(handle) != 0;
+}
+
 std::vector<heif_item_id> HeifImageHandle::get_list_of_metadata_block_IDs(
     const std::string& type_filter) {
     int count = heif_image_handle_get_number_of_metadata_blocks(
@@ -44,19 +518,70 @@ std::string HeifImageHandle::get_metadata_block_type(heif_item_id id) {
     return heif_image_handle_get_metadata_type(handle, id);
 }
 
+// Uninitialized bytes object, filled in place by libheif so each block is copied once
+static py::bytes new_bytes(size_t size) {
+    PyObject* data = PyBytes_FromStringAndSize(nullptr, static_cast<py::ssize_t>(size));
+    if (!data) {
+        throw py::error_already_set();
+    }
+    return py::reinterpret_steal<py::bytes>(data);
+}
+
 py::bytes HeifImageHandle::get_metadata_block(heif_item_id id) {
-    size_t size = heif_image_handle_get_metadata_size(handle, id);
-    std::vector<uint8_t> data(size);
-    check_error(heif_image_handle_get_metadata(handle, id, data.data()));
-    return py::bytes((char*)data.data(), size);
+    py::bytes data = new_bytes(heif_image_handle_get_metadata_size(handle, id));
+    char* dst = PyBytes_AS_STRING(data.ptr());
+    {
+        py::gil_scoped_release release;
+        check_error(heif_image_handle_get_metadata(handle, id, dst));
+    }
+    return data;
+}
+
+std::vector<MetadataBlock> HeifImageHandle::get_all_metadata(const std::string& type_filter) {
+    std::vector<MetadataBlock> blocks;
+    std::vector<char*> targets;
+    for (heif_item_id id : get_list_of_metadata_block_IDs(type_filter)) {
+        const char* content_type = heif_image_handle_get_metadata_content_type(handle, id);
+        py::bytes data = new_bytes(heif_image_handle_get_metadata_size(handle, id));
+        targets.push_back(PyBytes_AS_STRING(data.ptr()));
+        blocks.push_back({id, heif_image_handle_get_metadata_type(handle, id),
+                          content_type ? content_type : "", std::move(data)});
+    }
+
+    // The bytes objects are not shared yet, so they can be filled without the GIL
+    {
+        py::gil_scoped_release release;
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            check_error(heif_image_handle_get_metadata(handle, blocks[i].id, targets[i]));
+        }
+    }
+    return blocks;
 }
 
-HeifImage::HeifImage(int width, int height, heif_colorspace colorspace, heif_chroma chroma) {
+HeifImage::HeifImage(heif_image* img, bool poolable) : image(img), poolable(poolable) {
+    for (heif_channel channel : kAllChannels) {
+        if (heif_image_has_channel(image, channel)) {
+            layouts[channel] = describe_plane(image, channel);
+        }
+    }
+}
+
+HeifImage::HeifImage(int width, int height, heif_colorspace colorspace, heif_chroma chroma)
+    : poolable(true) {
     check_error(heif_image_create(width, height, colorspace, chroma, &image));
 }
 
+const PlaneLayout& HeifImage::plane_layout(heif_channel channel) const {
+    // Read-only, so images can be shared by native workers without a lock
+    auto it = layouts.find(channel);
+    if (it == layouts.end()) {
+        throw std::runtime_error("Failed to get image plane data");
+    }
+    return it->second;
+}
+
 HeifImage::~HeifImage() {
-    if (image) {
+    if (image && !(poolable && return_pooled_image(image))) {
         heif_image_release(image);
     }
 }
@@ -70,10 +595,49 @@ int HeifImage::get_height(heif_channel channel) const {
 }
 
 void HeifImage::add_plane(heif_channel channel, int width, int height, int bit_depth) {
+    ScopedTimer timer(Stage::Allocate);
+    // The first plane of a blank image can come from a recycled image of the same layout
+    if (poolable && layouts.empty() && image_pool_enabled()) {
+        heif_image* recycled = take_pooled_image(
+            heif_image_get_primary_width(image), heif_image_get_primary_height(image),
+            heif_image_get_colorspace(image), heif_image_get_chroma_format(image),
+            {{channel, width, height, bit_depth}});
+        if (recycled) {
+            heif_image_release(image);
+            image = recycled;
+            layouts[channel] = describe_plane(image, channel);
+            if (timer.enabled()) {
+                timer.add_bytes(image_bytes(image));
+            }
+            return;
+        }
+    }
     check_error(heif_image_add_plane(image, channel, width, height, bit_depth));
+    layouts[channel] = describe_plane(image, channel);
+    if (timer.enabled()) {
+        int stride;
+        heif_image_get_plane_readonly(image, channel, &stride);
+        timer.add_bytes(uint64_t(stride) * heif_image_get_height(image, channel));
+    }
+}
+
+int HeifImage::get_bits_per_pixel(heif_channel channel) const {
+    return heif_image_get_bits_per_pixel_range(image, channel);
+}
+
+std::optional<NclxColorProfile> HeifImage::get_nclx_color_profile() const {
+    heif_color_profile_nclx* nclx = nullptr;
+    if (heif_image_get_nclx_color_profile(image, &nclx).code != heif_error_Ok || !nclx) {
+        return std::nullopt;
+    }
+    NclxColorProfile profile = nclx_from_heif(nclx);
+    heif_nclx_color_profile_free(nclx);
+    return profile;
 }
 
 py::buffer_info HeifImage::get_buffer_info(heif_channel channel, bool writeable) {
+    const PlaneLayout& layout = plane_layout(channel);
+
     int stride;
     uint8_t* data;
     if (writeable) {
@@ -81,44 +645,145 @@ py::buffer_info HeifImage::get_buffer_info(heif_channel channel, bool writeable)
     } else {
         data = const_cast<uint8_t*>(heif_image_get_plane_readonly(image, channel, &stride));
     }
-
     if (!data) {
         throw std::runtime_error("Failed to get image plane data");
     }
+    if (stride < static_cast<int64_t>(layout.width) * layout.bytes_per_pixel()) {
+        throw std::runtime_error("Plane stride is smaller than its row size");
+    }
 
-    int width = heif_image_get_width(image, channel);
-    int height = heif_image_get_height(image, channel);
-    int bpp_per_channel = heif_image_get_bits_per_pixel_range(image, channel);
+    const py::ssize_t item = layout.bytes_per_channel;
+    if (layout.channels > 1) {
+        // Interleaved format: return 3D array (height, width, channels)
+        return py::buffer_info(data, item, layout.format(), 3,
+                               {layout.height, layout.width, layout.channels},
+                               {static_cast<py::ssize_t>(stride),
+                                static_cast<py::ssize_t>(layout.bytes_per_pixel()), item},
+                               !writeable);
+    }
+    // Single channel: return 2D array (height, width)
+    return py::buffer_info(data, item, layout.format(), 2, {layout.height, layout.width},
+                           {static_cast<py::ssize_t>(stride), item}, !writeable);
+}
 
-    // Determine number of channels for interleaved formats
-    int num_channels = 1;
-    heif_chroma chroma = heif_image_get_chroma_format(image);
-    if (chroma == heif_chroma_interleaved_RGB) {
-        num_channels = 3;
-    } else if (chroma == heif_chroma_interleaved_RGBA ||
-               chroma == heif_chroma_interleaved_RRGGBB_BE ||
-               chroma == heif_chroma_interleaved_RRGGBB_LE ||
-               chroma == heif_chroma_interleaved_RRGGBBAA_BE ||
-               chroma == heif_chroma_interleaved_RRGGBBAA_LE) {
-        num_channels = 4;
+void copy_image_into(const HeifImage& img, const py::buffer_info& out) {
+    ScopedTimer timer(Stage::Export);
+    const heif_image* src = img.get();
+    heif_chroma chroma = heif_image_get_chroma_format(src);
+    heif_channel channel =
+        chroma == heif_chroma_monochrome ? heif_channel_Y : heif_channel_interleaved;
+    if (!heif_image_has_channel(src, channel)) {
+        throw std::invalid_argument(
+            "Only interleaved RGB(A) and monochrome images can be copied into a buffer");
     }
 
-    size_t bytes_per_channel = (bpp_per_channel + 7) / 8;
-    std::string format = (bytes_per_channel == 1) ? py::format_descriptor<uint8_t>::format()
-                                                  : py::format_descriptor<uint16_t>::format();
+    const PlaneLayout& layout = img.plane_layout(channel);
+    const py::ssize_t width = layout.width;
+    const py::ssize_t height = layout.height;
+    const py::ssize_t bytes_per_channel = layout.bytes_per_channel;
+    const py::ssize_t channels = layout.channels;
 
-    if (num_channels > 1) {
-        // Interleaved format: return 3D array (height, width, channels)
-        return py::buffer_info(
-            data, bytes_per_channel, format, 3,
-            {(size_t)height, (size_t)width, (size_t)num_channels},
-            {(size_t)stride, (size_t)(num_channels * bytes_per_channel), bytes_per_channel},
-            !writeable);
-    } else {
-        // Single channel: return 2D array (height, width)
-        return py::buffer_info(data, bytes_per_channel, format, 2, {(size_t)height, (size_t)width},
-                               {(size_t)stride, bytes_per_channel}, !writeable);
+    if (!unsigned_integer_format(out.format)) {
+        throw py::type_error("Output buffer must have unsigned integer elements, not format '" +
+                             out.format + "'");
+    }
+
+    // Channel axis may be omitted for single-channel images
+    std::vector<py::ssize_t> expected = {height, width, channels};
+    if (channels == 1 && out.ndim == 2) {
+        expected.pop_back();
     }
+    if (out.shape != expected || out.itemsize != bytes_per_channel) {
+        std::string shape;
+        for (py::ssize_t dim : expected) {
+            shape += (shape.empty() ? "" : ", ") + std::to_string(dim);
+        }
+        throw std::invalid_argument("Output buffer must have shape (" + shape + ") and " +
+                                    std::to_string(bytes_per_channel * 8) + "-bit elements");
+    }
+
+    int src_stride;
+    const uint8_t* src_data = heif_image_get_plane_readonly(src, channel, &src_stride);
+    PixelLayout src_layout = {src_stride, channels * bytes_per_channel, bytes_per_channel};
+    PixelLayout dst_layout = {out.strides[0], out.strides[1],
+                              out.ndim == 3 ? out.strides[2] : bytes_per_channel};
+    copy_pixels(src_data, src_layout, static_cast<uint8_t*>(out.ptr), dst_layout, width, height,
+                channels, bytes_per_channel);
+    timer.add_bytes(uint64_t(width) * height * channels * bytes_per_channel);
+}
+
+std::shared_ptr<HeifImage> HeifImage::from_array(const py::buffer& array,
+                                                 heif_colorspace colorspace, heif_chroma chroma,
+                                                 int bit_depth) {
+    py::buffer_info info = array.request();
+    if (info.ndim != 2 && info.ndim != 3) {
+        throw std::invalid_argument("Array must have shape (height, width) or "
+                                    "(height, width, channels)");
+    }
+    if (info.itemsize != 1 && info.itemsize != 2) {
+        throw std::invalid_argument("Array must have uint8 or uint16 elements");
+    }
+    if (!unsigned_integer_format(info.format)) {
+        throw py::type_error("Array must have uint8 or uint16 elements, not format '" +
+                             info.format + "'");
+    }
+
+    const py::ssize_t height = info.shape[0];
+    const py::ssize_t width = info.shape[1];
+    const py::ssize_t channels = info.ndim == 3 ? info.shape[2] : 1;
+    const bool wide = info.itemsize == 2;
+
+    if (bit_depth == 0) {
+        if (wide) {
+            throw std::invalid_argument("bit_depth (e.g. 10, 12 or 16) is required for uint16 "
+                                        "arrays");
+        }
+        bit_depth = 8;
+    }
+    if ((wide && (bit_depth <= 8 || bit_depth > 16)) || (!wide && bit_depth != 8)) {
+        throw std::invalid_argument("bit_depth does not match the array element size");
+    }
+
+    // Infer the layout from the array; uint16 samples are stored in host byte order
+    if (chroma == heif_chroma_undefined) {
+        if (channels == 1) {
+            chroma = heif_chroma_monochrome;
+        } else if (channels == 3) {
+            chroma = wide ? native_hdr_chroma(false) : heif_chroma_interleaved_RGB;
+        } else if (channels == 4) {
+            chroma = wide ? native_hdr_chroma(true) : heif_chroma_interleaved_RGBA;
+        } else {
+            throw std::invalid_argument("Array must have 1, 3 or 4 channels");
+        }
+    }
+    if (colorspace == heif_colorspace_undefined) {
+        colorspace = chroma == heif_chroma_monochrome ? heif_colorspace_monochrome
+                                                      : heif_colorspace_RGB;
+    }
+
+    heif_channel channel =
+        chroma == heif_chroma_monochrome ? heif_channel_Y : heif_channel_interleaved;
+    auto image = std::make_shared<HeifImage>(static_cast<int>(width), static_cast<int>(height),
+                                             colorspace, chroma);
+    image->add_plane(channel, static_cast<int>(width), static_cast<int>(height), bit_depth);
+
+    heif_image* dst = image->get();
+    if (image->plane_layout(channel).bytes_per_pixel() != channels * info.itemsize) {
+        throw std::invalid_argument("Array shape does not match the requested chroma format");
+    }
+
+    int dst_stride;
+    uint8_t* dst_data = heif_image_get_plane(dst, channel, &dst_stride);
+    PixelLayout src_layout = {info.strides[0], info.strides[1],
+                              info.ndim == 3 ? info.strides[2] : info.itemsize};
+    PixelLayout dst_layout = {dst_stride, channels * info.itemsize, info.itemsize};
+
+    py::gil_scoped_release release;
+    ScopedTimer timer(Stage::Export);
+    copy_pixels(static_cast<const uint8_t*>(info.ptr), src_layout, dst_data, dst_layout, width,
+                height, channels, info.itemsize);
+    timer.add_bytes(uint64_t(width) * height * channels * info.itemsize);
+    return image;
 }
 
 }  // namespace pylibheif
@@ -1,17 +1,76 @@
 #pragma once
+#include <atomic>
+#include <cstdint>
 #include <map>
 #include <memory>
+#include <optional>
+#include <string>
 #include <vector>
 
 #include "common.hpp"
+#include "metadata.hpp"
 
 namespace pylibheif {
 
 class HeifImage;
+class CancelToken;
+class DecodingOptions;
+class MemoryBudget;
 
-class HeifImageHandle {
+// Every plane a heif_image can carry
+inline const heif_channel kAllChannels[] = {
+    heif_channel_Y, heif_channel_Cb, heif_channel_Cr,    heif_channel_R,
+    heif_channel_G, heif_channel_B,  heif_channel_Alpha, heif_channel_interleaved};
+
+enum class ByteOrder { Native, Big, Little };
+
+// Memory layout of one plane: a (height, width[, channels]) array of 8- or 16-bit samples
+struct PlaneLayout {
+    int width = 0;
+    int height = 0;
+    int channels = 1;
+    int bytes_per_channel = 1;
+    int bits = 8;  // Significant bits per sample
+    ByteOrder byte_order = ByteOrder::Native;
+
+    int bytes_per_pixel() const { return channels * bytes_per_channel; }
+    // Buffer protocol format ("B", "H", ">H" or "<H")
+    std::string format() const;
+};
+
+// Describes a plane of img from its chroma format; the channel must exist
+PlaneLayout describe_plane(const heif_image* img, heif_channel channel);
+
+// Tile grid of an image as reported by heif_image_handle_get_image_tiling
+struct ImageTiling {
+    uint32_t num_columns = 1;
+    uint32_t num_rows = 1;
+    uint32_t tile_width = 0;
+    uint32_t tile_height = 0;
+    uint32_t image_width = 0;
+    uint32_t image_height = 0;
+    // Shift of the top-left tile for cropped or rotated images
+    uint32_t top_offset = 0;
+    uint32_t left_offset = 0;
+};
+
+// How the samples of a depth image map to distances ('depth representation info' SEI)
+struct DepthRepresentation {
+    heif_depth_representation_type type = heif_depth_representation_type_uniform_inverse_Z;
+    std::optional<double> z_near;
+    std::optional<double> z_far;
+    std::optional<double> d_min;
+    std::optional<double> d_max;
+    uint32_t disparity_reference_view = 0;
+};
+
+class HeifImageHandle : public std::enable_shared_from_this<HeifImageHandle> {
    public:
-    HeifImageHandle(heif_image_handle* h) : handle(h) {}
+    // tile_threads is the owning context's max_decoding_threads (shared, so later changes
+    // are seen); without it decode estimates assume libheif's default
+    HeifImageHandle(heif_image_handle* h,
+                    std::shared_ptr<const std::atomic<int>> tile_threads = nullptr)
+        : handle(h), tile_threads(std::move(tile_threads)) {}
     ~HeifImageHandle();
 
     int get_width() const;
@@ -20,27 +79,96 @@ class HeifImageHandle {
     int get_luma_bits_per_pixel() const;
     int get_chroma_bits_per_pixel() const;
 
-    std::shared_ptr<HeifImage> decode(heif_colorspace colorspace, heif_chroma chroma);
+    // A non-zero max_width/max_height downscales the decoded image to fit (area filter).
+    // The decode methods stop with a canceled HeifError once `cancel` fires. With a budget,
+    // the decode waits until its estimated memory fits and holds it until it returns.
+    std::shared_ptr<HeifImage> decode(heif_colorspace colorspace, heif_chroma chroma,
+                                      const DecodingOptions* options = nullptr,
+                                      int max_width = 0, int max_height = 0,
+                                      const CancelToken* cancel = nullptr,
+                                      MemoryBudget* budget = nullptr);
+    // Decodes to 16-bit interleaved RGB(A) in host byte order, keeping the source bit depth
+    // (never reduced to 8 bits). alpha defaults to whether the image has an alpha channel.
+    std::shared_ptr<HeifImage> decode_hdr(std::optional<bool> alpha = std::nullopt,
+                                          const DecodingOptions* options = nullptr,
+                                          const CancelToken* cancel = nullptr);
+    // NCLX profile stored in the file (e.g. BT.2020 with PQ or HLG transfer), if any
+    std::optional<NclxColorProfile> get_nclx_color_profile() const;
+
+    // Decodes and writes the converted pixels into a caller-owned (possibly strided) buffer
+    void decode_into(const py::buffer& out, heif_colorspace colorspace, heif_chroma chroma,
+                     const DecodingOptions* options = nullptr,
+                     const CancelToken* cancel = nullptr, MemoryBudget* budget = nullptr);
+    // Peak bytes a decode to colorspace/chroma is expected to allocate (see MemoryBudget)
+    uint64_t estimate_decode_bytes(heif_colorspace colorspace, heif_chroma chroma) const;
+
+    // Tiles (grid images are split into independently coded tiles; other images are one tile)
+    ImageTiling get_tiling(bool process_transformations = true) const;
+    std::shared_ptr<HeifImage> decode_tile(uint32_t tile_x, uint32_t tile_y,
+                                           heif_colorspace colorspace, heif_chroma chroma,
+                                           const DecodingOptions* options = nullptr,
+                                           const CancelToken* cancel = nullptr);
+    // Decodes only the tiles intersecting the rectangle and assembles the crop
+    std::shared_ptr<HeifImage> decode_region(int x, int y, int width, int height,
+                                             heif_colorspace colorspace, heif_chroma chroma,
+                                             const DecodingOptions* options = nullptr,
+                                             const CancelToken* cancel = nullptr);
+
+    // Thumbnails
+    int get_number_of_thumbnails() const;
+    std::vector<heif_item_id> get_list_of_thumbnail_IDs() const;
+    std::shared_ptr<HeifImageHandle> get_thumbnail(heif_item_id id) const;
+    // Smallest stored thumbnail covering min_width x min_height, or this image if none does
+    std::shared_ptr<HeifImageHandle> get_thumbnail_for_size(int min_width, int min_height);
+
+    // Depth and auxiliary images are separate handles; nothing is decoded until asked for
+    std::vector<heif_item_id> get_list_of_depth_image_IDs() const;
+    std::shared_ptr<HeifImageHandle> get_depth_image(heif_item_id id) const;
+    std::optional<DepthRepresentation> get_depth_representation(heif_item_id id) const;
+    // Auxiliary images (gain maps, mattes); alpha and depth are left out unless asked for
+    std::vector<heif_item_id> get_list_of_auxiliary_image_IDs(bool include_alpha = false,
+                                                              bool include_depth = false) const;
+    std::shared_ptr<HeifImageHandle> get_auxiliary_image(heif_item_id id) const;
+    // URN of an auxiliary image (e.g. "urn:com:apple:photo:2020:aux:hdrgainmap"); empty
+    // for other images
+    std::string get_auxiliary_type() const;
+    // First auxiliary image whose type is a known HDR gain map, or nullptr
+    std::shared_ptr<HeifImageHandle> get_gain_map() const;
+    bool is_premultiplied_alpha() const;
 
     // Metadata
     std::vector<heif_item_id> get_list_of_metadata_block_IDs(const std::string& type_filter = "");
     std::string get_metadata_block_type(heif_item_id id);
     py::bytes get_metadata_block(heif_item_id id);
+    // Every block (optionally of one type) in one call; the payloads are read without the GIL
+    std::vector<MetadataBlock> get_all_metadata(const std::string& type_filter = "");
 
     heif_image_handle* get() const { return handle; }
 
    private:
     heif_image_handle* handle;
+    std::shared_ptr<const std::atomic<int>> tile_threads;
 };
 
 class HeifImage {
    public:
-    HeifImage(heif_image* img) : image(img) {}
+    // poolable marks images allocated by pylibheif, which may go back to the image pool
+    HeifImage(heif_image* img, bool poolable = false);
     HeifImage(int width, int height, heif_colorspace colorspace, heif_chroma chroma);
     ~HeifImage();
 
+    // Builds an image from a (height, width[, channels]) uint8/uint16 array with a single
+    // copy. Undefined colorspace/chroma are inferred from the array shape and dtype.
+    static std::shared_ptr<HeifImage> from_array(const py::buffer& array,
+                                                 heif_colorspace colorspace, heif_chroma chroma,
+                                                 int bit_depth);
+
     int get_width(heif_channel channel) const;
     int get_height(heif_channel channel) const;
+    int get_bits_per_pixel(heif_channel channel) const;
+    // Layout of a plane, computed once and cached; throws if the image has no such plane
+    const PlaneLayout& plane_layout(heif_channel channel) const;
+    std::optional<NclxColorProfile> get_nclx_color_profile() const;
     void add_plane(heif_channel channel, int width, int height, int bit_depth);
 
     // Buffer protocol support
@@ -50,6 +178,16 @@ class HeifImage {
 
    private:
     heif_image* image;
+    bool poolable = false;
+    // Every plane, described in the constructor and add_plane; never modified by readers
+    std::map<heif_channel, PlaneLayout> layouts;
 };
 
+// Copies the interleaved or monochrome pixels of img into out, which must match its
+// shape and element size. Only touches raw memory, so it may run without the GIL.
+void copy_image_into(const HeifImage& img, const py::buffer_info& out);
+
+// Copies the NCLX and ICC color profiles of src to dst (best effort)
+void copy_color_profiles(const heif_image* src, heif_image* dst);
+
 }  // namespace pylibheif
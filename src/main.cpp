@@ -1,20 +1,67 @@
+#include <algorithm>
+#include <memory>
+#include <vector>
+
 #include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 
+#include "batch.hpp"
+#include "budget.hpp"
+#include "cancel.hpp"
 #include "context.hpp"
+#include "decoder.hpp"
+#include "dlpack.hpp"
 #include "encoder.hpp"
 #include "image.hpp"
+#include "metrics.hpp"
+#include "pixel_ops.hpp"
+#include "metadata.hpp"
+#include "metadata_edit.hpp"
+#include "pickle.hpp"
+#include "pool.hpp"
+#include "probe.hpp"
+#include "sequence.hpp"
+#include "stats.hpp"
+#include "target.hpp"
+#include "transcode.hpp"
+#include "work_queue.hpp"
 
 namespace py = pybind11;
 using namespace pylibheif;
 
+// Adds __dlpack__, __dlpack_device__ and __array_interface__ backed by view(self)
+template <typename Class, typename ViewFn>
+static void def_tensor_exports(Class& cls, ViewFn view) {
+    cls.def(
+           "__dlpack__",
+           [view](py::object self, py::object stream, py::object max_version,
+                  py::object dl_device, py::object copy) {
+               return to_dlpack(view(self), stream, max_version, dl_device, copy);
+           },
+           py::kw_only(), py::arg("stream") = py::none(), py::arg("max_version") = py::none(),
+           py::arg("dl_device") = py::none(), py::arg("copy") = py::none(),
+           "Zero-copy DLPack capsule for torch/jax/cupy.from_dlpack; the capsule keeps the "
+           "pixels alive.")
+        .def("__dlpack_device__", [](py::object) { return dlpack_device(); })
+        .def_property_readonly("__array_interface__",
+                               [view](py::object self) { return array_interface(view(self)); });
+}
+
+// Queues created from Python, guarded by the GIL. A single atexit hook stops the workers of
+// those still alive, which must be gone before the interpreter finalizes.
+static std::vector<std::weak_ptr<WorkQueue>>& live_work_queues() {
+    static std::vector<std::weak_ptr<WorkQueue>> queues;
+    return queues;
+}
+
 class HeifPlane {
    public:
     HeifPlane(std::shared_ptr<HeifImage> img, heif_channel channel, bool writeable)
         : img(img), channel(channel), writeable(writeable) {}
 
     py::buffer_info get_buffer_info() { return img->get_buffer_info(channel, writeable); }
+    TensorView view() const { return plane_view(img, channel, writeable); }
 
    private:
     std::shared_ptr<HeifImage> img;
@@ -38,6 +85,14 @@ PYBIND11_MODULE(_pylibheif, m) {
         .value("EncoderPluginError", heif_error_Encoder_plugin_error)
         .value("EncodingError", heif_error_Encoding_error)
         .value("ColorProfileDoesNotExist", heif_error_Color_profile_does_not_exist)
+#ifdef PYLIBHEIF_HAVE_CANCEL_DECODING
+        .value("Canceled", heif_error_Canceled)
+#endif
+        .export_values();
+
+    py::enum_<heif_progress_step>(m, "HeifProgressStep")
+        .value("Total", heif_progress_step_total)
+        .value("LoadTile", heif_progress_step_load_tile)
         .export_values();
 
     py::enum_<heif_colorspace>(m, "HeifColorspace")
@@ -55,6 +110,10 @@ PYBIND11_MODULE(_pylibheif, m) {
         .value("C444", heif_chroma_444)
         .value("InterleavedRGB", heif_chroma_interleaved_RGB)
         .value("InterleavedRGBA", heif_chroma_interleaved_RGBA)
+        .value("InterleavedRRGGBB_BE", heif_chroma_interleaved_RRGGBB_BE)
+        .value("InterleavedRRGGBBAA_BE", heif_chroma_interleaved_RRGGBBAA_BE)
+        .value("InterleavedRRGGBB_LE", heif_chroma_interleaved_RRGGBB_LE)
+        .value("InterleavedRRGGBBAA_LE", heif_chroma_interleaved_RRGGBBAA_LE)
         .export_values();
 
     py::enum_<heif_channel>(m, "HeifChannel")
@@ -77,19 +136,171 @@ PYBIND11_MODULE(_pylibheif, m) {
         .value("JPEG2000", heif_compression_JPEG2000)
         .export_values();
 
+    py::enum_<heif_chroma_upsampling_algorithm>(m, "HeifChromaUpsampling")
+        .value("NearestNeighbor", heif_chroma_upsampling_nearest_neighbor)
+        .value("Bilinear", heif_chroma_upsampling_bilinear)
+        .export_values();
+
+    py::enum_<heif_chroma_downsampling_algorithm>(m, "HeifChromaDownsampling")
+        .value("NearestNeighbor", heif_chroma_downsampling_nearest_neighbor)
+        .value("Average", heif_chroma_downsampling_average)
+        .value("SharpYUV", heif_chroma_downsampling_sharp_yuv)
+        .export_values();
+
+    py::enum_<heif_color_primaries>(m, "HeifColorPrimaries")
+        .value("BT709", heif_color_primaries_ITU_R_BT_709_5)
+        .value("Unspecified", heif_color_primaries_unspecified)
+        .value("BT601", heif_color_primaries_ITU_R_BT_601_6)
+        .value("BT2020", heif_color_primaries_ITU_R_BT_2020_2_and_2100_0)
+        .value("DisplayP3", heif_color_primaries_SMPTE_EG_432_1)
+        .export_values();
+
+    py::enum_<heif_transfer_characteristics>(m, "HeifTransferCharacteristics")
+        .value("BT709", heif_transfer_characteristic_ITU_R_BT_709_5)
+        .value("Unspecified", heif_transfer_characteristic_unspecified)
+        .value("Linear", heif_transfer_characteristic_linear)
+        .value("SRGB", heif_transfer_characteristic_IEC_61966_2_1)
+        .value("PQ", heif_transfer_characteristic_ITU_R_BT_2100_0_PQ)
+        .value("HLG", heif_transfer_characteristic_ITU_R_BT_2100_0_HLG)
+        .export_values();
+
+    py::enum_<heif_matrix_coefficients>(m, "HeifMatrixCoefficients")
+        .value("RGB", heif_matrix_coefficients_RGB_GBR)
+        .value("BT709", heif_matrix_coefficients_ITU_R_BT_709_5)
+        .value("Unspecified", heif_matrix_coefficients_unspecified)
+        .value("BT601", heif_matrix_coefficients_ITU_R_BT_601_6)
+        .value("BT2020NCL", heif_matrix_coefficients_ITU_R_BT_2020_2_non_constant_luminance)
+        .export_values();
+
+    py::enum_<heif_orientation>(m, "HeifOrientation")
+        .value("Normal", heif_orientation_normal)
+        .value("FlipHorizontally", heif_orientation_flip_horizontally)
+        .value("Rotate180", heif_orientation_rotate_180)
+        .value("FlipVertically", heif_orientation_flip_vertically)
+        .value("Rotate90CWThenFlipHorizontally",
+               heif_orientation_rotate_90_cw_then_flip_horizontally)
+        .value("Rotate90CW", heif_orientation_rotate_90_cw)
+        .value("Rotate90CWThenFlipVertically", heif_orientation_rotate_90_cw_then_flip_vertically)
+        .value("Rotate270CW", heif_orientation_rotate_270_cw)
+        .export_values();
+
+    py::enum_<heif_depth_representation_type>(m, "HeifDepthRepresentationType")
+        .value("UniformInverseZ", heif_depth_representation_type_uniform_inverse_Z)
+        .value("UniformDisparity", heif_depth_representation_type_uniform_disparity)
+        .value("UniformZ", heif_depth_representation_type_uniform_Z)
+        .value("NonuniformDisparity", heif_depth_representation_type_nonuniform_disparity)
+        .export_values();
+
     // Exception
     py::register_exception<HeifError>(m, "HeifError");
 
     // Classes
+    py::class_<CancelToken, std::shared_ptr<CancelToken>>(m, "CancelToken")
+        .def(py::init<std::optional<double>>(), py::arg("deadline_ms") = py::none(),
+             "Cancellation flag for long decodes and encodes. deadline_ms (relative to now) "
+             "makes it fire on its own.")
+        .def("cancel", &CancelToken::cancel, "Request cancellation; safe from any thread.")
+        .def("child", &CancelToken::child, py::arg("deadline_ms") = py::none(),
+             "New token that fires with this one or on its own deadline; cancelling the child "
+             "leaves this token untouched.")
+        .def_property_readonly("cancelled", &CancelToken::is_canceled)
+        .def("set_deadline_ms", &CancelToken::set_deadline_ms, py::arg("deadline_ms"),
+             "Fire deadline_ms milliseconds from now (None removes the deadline).")
+        .def_property_readonly("remaining_ms", &CancelToken::remaining_ms);
+
+    py::class_<MemoryBudget, std::shared_ptr<MemoryBudget>>(m, "MemoryBudget")
+        .def(py::init<uint64_t>(), py::arg("limit"),
+             "Byte budget shared by decodes. Budgeted decodes wait, in arrival order, until "
+             "their estimated peak memory fits; an image larger than the limit runs alone.")
+        .def_property("limit", &MemoryBudget::get_limit, &MemoryBudget::set_limit)
+        .def_property_readonly("in_use", &MemoryBudget::in_use)
+        .def_property_readonly("peak", &MemoryBudget::peak)
+        .def_property_readonly("waiting", &MemoryBudget::waiting)
+        .def_property_readonly("admitted", &MemoryBudget::admitted)
+        .def("acquire", &MemoryBudget::acquire, py::arg("bytes"), py::arg("cancel") = nullptr,
+             py::call_guard<py::gil_scoped_release>(),
+             "Reserve bytes for custom work, waiting until they fit. Pair with release().")
+        .def("release", &MemoryBudget::release, py::arg("bytes"))
+        .def("__repr__", [](const MemoryBudget& b) {
+            return "MemoryBudget(limit=" + std::to_string(b.get_limit()) +
+                   ", in_use=" + std::to_string(b.in_use()) +
+                   ", waiting=" + std::to_string(b.waiting()) + ")";
+        });
+
+    py::class_<SecurityLimits>(m, "HeifSecurityLimits")
+        .def(py::init<>(), "libheif's default limits; 0 disables a limit.")
+        .def_static("disabled", &SecurityLimits::disabled)
+        .def_readwrite("max_image_size_pixels", &SecurityLimits::max_image_size_pixels)
+        .def_readwrite("max_number_of_tiles", &SecurityLimits::max_number_of_tiles)
+        .def_readwrite("max_items", &SecurityLimits::max_items)
+        .def_readwrite("max_memory_block_size", &SecurityLimits::max_memory_block_size)
+        .def_readwrite("max_components", &SecurityLimits::max_components)
+        .def_readwrite("max_color_profile_size", &SecurityLimits::max_color_profile_size)
+        .def_readwrite("max_total_memory", &SecurityLimits::max_total_memory)
+        .def("__repr__", [](const SecurityLimits& l) {
+            return "HeifSecurityLimits(max_image_size_pixels=" +
+                   std::to_string(l.max_image_size_pixels) +
+                   ", max_number_of_tiles=" + std::to_string(l.max_number_of_tiles) +
+                   ", max_total_memory=" + std::to_string(l.max_total_memory) + ")";
+        });
+
     py::class_<HeifContext, std::shared_ptr<HeifContext>>(m, "HeifContext")
         .def(py::init<>())
         .def("read_from_file", &HeifContext::read_from_file)
-        .def("read_from_memory", &HeifContext::read_from_memory)
-        .def("get_primary_image_handle", &HeifContext::get_primary_image_handle)
+        .def("read_from_memory", &HeifContext::read_from_memory, py::arg("data"),
+             "Read a HEIF file from any C-contiguous buffer (bytes, bytearray, memoryview, "
+             "numpy array, mmap). The buffer is referenced, not copied, for the context's "
+             "lifetime.")
+        .def("read_from_mmap", &HeifContext::read_from_mmap, py::arg("filename"),
+             "Read a HEIF file lazily through a read-only memory map; only the byte ranges "
+             "libheif requests are paged in.")
+        .def("read_from_stream", &HeifContext::read_from_stream, py::arg("fileobj"),
+             "Read a HEIF file lazily from a seekable binary file object using readinto() and "
+             "seek(). Only the requested byte ranges are read, with the GIL taken just for "
+             "those calls. The object must stay open while the context is used.")
+        .def("get_primary_image_handle", &HeifContext::get_primary_image_handle,
+             py::keep_alive<0, 1>())
         .def("get_list_of_top_level_image_IDs", &HeifContext::get_list_of_top_level_image_IDs)
-        .def("get_image_handle", &HeifContext::get_image_handle)
+        .def("has_sequence", &context_has_sequence,
+             "True if the file contains an image sequence or animation track.")
+        .def("get_track_ids", &context_track_ids)
+        .def(
+            "get_sequence",
+            [](HeifContext& self, uint32_t track_id, heif_colorspace colorspace,
+               heif_chroma chroma, std::shared_ptr<DecodingOptions> options) {
+                return std::make_shared<HeifSequence>(self, track_id, colorspace, chroma,
+                                                      std::move(options));
+            },
+            py::arg("track_id") = 0, py::arg("colorspace") = heif_colorspace_RGB,
+            py::arg("chroma") = heif_chroma_interleaved_RGB, py::arg("options") = nullptr,
+            py::keep_alive<0, 1>(),
+            "Frame reader for a sequence track (0 = first visual track).")
+        .def("decode_all", &HeifContext::decode_all, py::arg("ids") = py::none(),
+             py::arg("colorspace") = heif_colorspace_RGB,
+             py::arg("chroma") = heif_chroma_interleaved_RGB, py::arg("threads") = 0,
+             py::arg("options") = nullptr, py::arg("cancel") = nullptr,
+             py::arg("budget") = nullptr,
+             "Decode several images of this context (default: all top-level images) in "
+             "parallel on `threads` native workers (0 = one per core) without the GIL. "
+             "Returns the images in the order of `ids`.")
+        .def("get_image_handle", &HeifContext::get_image_handle, py::keep_alive<0, 1>())
+        .def_property("max_decoding_threads", &HeifContext::get_max_decoding_threads,
+                      &HeifContext::set_max_decoding_threads,
+                      "Maximum number of threads libheif uses to decode the tiles of one image. "
+                      "Set to 0 when decoding many images in parallel. -1 means libheif's "
+                      "default.")
+        .def_property("security_limits", &HeifContext::get_security_limits,
+                      &HeifContext::set_security_limits,
+                      "Limits (image pixels, tiles, memory) libheif enforces for this context. "
+                      "Assign a modified copy before reading a file.")
         .def("write_to_file", &HeifContext::write_to_file)
         .def("write_to_bytes", &HeifContext::write_to_bytes)
+        .def("write_to", &HeifContext::write_to, py::arg("fileobj"),
+             "Stream the encoded file to a writable file-like object (anything with a "
+             "write() method). Returns the number of bytes written.")
+        .def("write_into", &HeifContext::write_into, py::arg("buffer"),
+             "Write the encoded file into a preallocated writable buffer (bytearray, "
+             "memoryview, numpy array). Returns the number of bytes written.")
         .def("add_exif_metadata", &HeifContext::add_exif_metadata, py::arg("handle"),
              py::arg("data"), "Add EXIF metadata to an image. The data should be raw EXIF bytes.")
         .def("add_xmp_metadata", &HeifContext::add_xmp_metadata, py::arg("handle"), py::arg("data"),
@@ -101,50 +312,547 @@ PYBIND11_MODULE(_pylibheif, m) {
         .def("__enter__", [](HeifContext& self) { return &self; })
         .def("__exit__", [](HeifContext& self, py::args) {});
 
+    py::class_<HeifDecoderDescriptor>(m, "HeifDecoderDescriptor")
+        .def_property_readonly("id_name", &HeifDecoderDescriptor::id_name)
+        .def_property_readonly("name", &HeifDecoderDescriptor::name);
+
+    m.def("get_decoder_descriptors", &get_decoder_descriptors,
+          py::arg("format_filter") = heif_compression_undefined);
+
+    py::class_<DecodingOptions, std::shared_ptr<DecodingOptions>>(m, "DecodingOptions")
+        .def(py::init<>())
+        .def_property("ignore_transformations", &DecodingOptions::get_ignore_transformations,
+                      &DecodingOptions::set_ignore_transformations,
+                      "Skip rotation, mirroring and cropping stored in the file.")
+        .def_property("convert_hdr_to_8bit", &DecodingOptions::get_convert_hdr_to_8bit,
+                      &DecodingOptions::set_convert_hdr_to_8bit,
+                      "Convert high bit depth images to 8 bits per channel.")
+        .def_property("strict_decoding", &DecodingOptions::get_strict_decoding,
+                      &DecodingOptions::set_strict_decoding,
+                      "Fail on invalid input instead of decoding as much as possible.")
+        .def_property("decoder_id", &DecodingOptions::get_decoder_id,
+                      &DecodingOptions::set_decoder_id,
+                      "id_name of the decoder plugin to use (see get_decoder_descriptors). "
+                      "Empty selects the default decoder.")
+        .def_property("chroma_upsampling", &DecodingOptions::get_chroma_upsampling,
+                      &DecodingOptions::set_chroma_upsampling)
+        .def_property("chroma_downsampling", &DecodingOptions::get_chroma_downsampling,
+                      &DecodingOptions::set_chroma_downsampling)
+        .def_property("only_use_preferred_chroma_algorithm",
+                      &DecodingOptions::get_only_use_preferred_chroma_algorithm,
+                      &DecodingOptions::set_only_use_preferred_chroma_algorithm,
+                      "Restrict color conversion to the preferred chroma algorithms. "
+                      "NearestNeighbor gives the fastest conversion, e.g. for thumbnails.")
+        .def_property("progress", &DecodingOptions::get_progress, &DecodingOptions::set_progress,
+                      "Callable(step, progress, max_progress) invoked as libheif reports "
+                      "decoding progress (e.g. per grid tile). Raising from it cancels the "
+                      "decode and re-raises the exception.");
+
+    py::class_<ImageTiling>(m, "HeifImageTiling")
+        .def_readonly("num_columns", &ImageTiling::num_columns)
+        .def_readonly("num_rows", &ImageTiling::num_rows)
+        .def_readonly("tile_width", &ImageTiling::tile_width)
+        .def_readonly("tile_height", &ImageTiling::tile_height)
+        .def_readonly("image_width", &ImageTiling::image_width)
+        .def_readonly("image_height", &ImageTiling::image_height)
+        .def_readonly("top_offset", &ImageTiling::top_offset)
+        .def_readonly("left_offset", &ImageTiling::left_offset)
+        .def("__repr__", [](const ImageTiling& t) {
+            return "HeifImageTiling(" + std::to_string(t.num_columns) + "x" +
+                   std::to_string(t.num_rows) + " tiles of " + std::to_string(t.tile_width) +
+                   "x" + std::to_string(t.tile_height) + ")";
+        });
+
+    py::class_<DepthRepresentation>(m, "HeifDepthRepresentation")
+        .def_readonly("type", &DepthRepresentation::type)
+        .def_readonly("z_near", &DepthRepresentation::z_near)
+        .def_readonly("z_far", &DepthRepresentation::z_far)
+        .def_readonly("d_min", &DepthRepresentation::d_min)
+        .def_readonly("d_max", &DepthRepresentation::d_max)
+        .def_readonly("disparity_reference_view", &DepthRepresentation::disparity_reference_view)
+        .def("__repr__", [](const DepthRepresentation& d) {
+            return "HeifDepthRepresentation(type=" + std::to_string(static_cast<int>(d.type)) +
+                   ")";
+        });
+
+    py::class_<HeifFrame>(m, "HeifFrame")
+        .def_readonly("image", &HeifFrame::image)
+        .def_readonly("index", &HeifFrame::index)
+        .def_readonly("timestamp", &HeifFrame::timestamp)
+        .def_readonly("duration", &HeifFrame::duration)
+        .def("__repr__", [](const HeifFrame& f) {
+            return "HeifFrame(index=" + std::to_string(f.index) +
+                   ", timestamp=" + std::to_string(f.timestamp) + ")";
+        });
+
+    py::class_<HeifSequence, std::shared_ptr<HeifSequence>>(m, "HeifSequence")
+        .def_property_readonly("track_id", &HeifSequence::get_track_id)
+        .def_property_readonly("width", &HeifSequence::get_width)
+        .def_property_readonly("height", &HeifSequence::get_height)
+        .def_property_readonly("timescale", &HeifSequence::get_timescale)
+        .def("__iter__", [](py::object self) { return self; })
+        .def("__next__",
+             [](HeifSequence& self) {
+                 std::optional<HeifFrame> frame = self.next();
+                 if (!frame) {
+                     throw py::stop_iteration();
+                 }
+                 return std::move(*frame);
+             })
+        .def("next_into", &HeifSequence::next_into, py::arg("out"),
+             "Decode the next frame into a writable (height, width[, channels]) buffer that "
+             "can be reused for every frame. Returns the frame timing (image is None), or None "
+             "at the end of the track.")
+        .def("skip", &HeifSequence::skip, py::arg("count"),
+             "Decode and drop up to `count` frames; returns how many were skipped.");
+
     py::class_<HeifImageHandle, std::shared_ptr<HeifImageHandle>>(m, "HeifImageHandle")
         .def_property_readonly("width", &HeifImageHandle::get_width)
         .def_property_readonly("height", &HeifImageHandle::get_height)
         .def_property_readonly("has_alpha", &HeifImageHandle::has_alpha_channel)
+        .def_property_readonly("luma_bits_per_pixel", &HeifImageHandle::get_luma_bits_per_pixel)
         .def("decode", &HeifImageHandle::decode, py::arg("colorspace") = heif_colorspace_RGB,
+             py::arg("chroma") = heif_chroma_interleaved_RGB, py::arg("options") = nullptr,
+             py::arg("max_width") = 0, py::arg("max_height") = 0, py::arg("cancel") = nullptr,
+             py::arg("budget") = nullptr, py::call_guard<py::gil_scoped_release>(),
+             "Decode the image. A non-zero max_width/max_height downscales it with an area "
+             "filter to fit into that box (aspect ratio kept, never upscaled).")
+        .def("decode_hdr", &HeifImageHandle::decode_hdr, py::arg("alpha") = py::none(),
+             py::arg("options") = nullptr, py::arg("cancel") = nullptr,
+             py::call_guard<py::gil_scoped_release>(),
+             "Decode to 16-bit interleaved RGB(A) in host byte order (a plain uint16 array) "
+             "at the source bit depth, never reducing to 8 bits. The image keeps the file's "
+             "NCLX profile (e.g. PQ/HLG transfer).")
+        .def("get_nclx_color_profile", &HeifImageHandle::get_nclx_color_profile,
+             "NCLX color profile stored in the file, or None.")
+        .def("decode_into", &HeifImageHandle::decode_into, py::arg("out"),
+             py::arg("colorspace") = heif_colorspace_RGB,
+             py::arg("chroma") = heif_chroma_interleaved_RGB, py::arg("options") = nullptr,
+             py::arg("cancel") = nullptr, py::arg("budget") = nullptr,
+             "Decode directly into a writable (height, width, channels) buffer such as a "
+             "numpy array or a slice of a preallocated batch.")
+        .def("estimate_decode_bytes", &HeifImageHandle::estimate_decode_bytes,
+             py::arg("colorspace") = heif_colorspace_RGB,
              py::arg("chroma") = heif_chroma_interleaved_RGB,
-             py::call_guard<py::gil_scoped_release>())
+             "Peak bytes a decode is expected to allocate (codec output, color conversion and "
+             "tile buffers), computed from the image properties without decoding.")
+        .def("get_tiling", &HeifImageHandle::get_tiling, py::arg("process_transformations") = true)
+        .def("decode_tile", &HeifImageHandle::decode_tile, py::arg("tile_x"), py::arg("tile_y"),
+             py::arg("colorspace") = heif_colorspace_RGB,
+             py::arg("chroma") = heif_chroma_interleaved_RGB, py::arg("options") = nullptr,
+             py::arg("cancel") = nullptr, py::call_guard<py::gil_scoped_release>())
+        .def("decode_region", &HeifImageHandle::decode_region, py::arg("x"), py::arg("y"),
+             py::arg("width"), py::arg("height"), py::arg("colorspace") = heif_colorspace_RGB,
+             py::arg("chroma") = heif_chroma_interleaved_RGB, py::arg("options") = nullptr,
+             py::arg("cancel") = nullptr, py::call_guard<py::gil_scoped_release>(),
+             "Decode only the tiles intersecting the rectangle and return the cropped image.")
+        .def_property_readonly("num_thumbnails", &HeifImageHandle::get_number_of_thumbnails)
+        .def("get_thumbnail_ids", &HeifImageHandle::get_list_of_thumbnail_IDs)
+        .def("get_thumbnail", &HeifImageHandle::get_thumbnail, py::arg("id"),
+             py::keep_alive<0, 1>())
+        .def("get_thumbnail_for_size", &HeifImageHandle::get_thumbnail_for_size,
+             py::arg("min_width"), py::arg("min_height"), py::keep_alive<0, 1>(),
+             "Return the smallest stored thumbnail whose dimensions are at least "
+             "min_width x min_height, or this image if no thumbnail is large enough.")
+        .def_property_readonly("is_premultiplied_alpha", &HeifImageHandle::is_premultiplied_alpha)
+        .def("get_depth_image_ids", &HeifImageHandle::get_list_of_depth_image_IDs)
+        .def("get_depth_image", &HeifImageHandle::get_depth_image, py::arg("id"),
+             py::keep_alive<0, 1>(),
+             "Handle of a depth map; decode it like any image (typically monochrome).")
+        .def("get_depth_representation", &HeifImageHandle::get_depth_representation,
+             py::arg("id"), "How the samples of depth image `id` map to distances, or None.")
+        .def("get_auxiliary_image_ids", &HeifImageHandle::get_list_of_auxiliary_image_IDs,
+             py::arg("include_alpha") = false, py::arg("include_depth") = false)
+        .def("get_auxiliary_image", &HeifImageHandle::get_auxiliary_image, py::arg("id"),
+             py::keep_alive<0, 1>())
+        .def_property_readonly("auxiliary_type", &HeifImageHandle::get_auxiliary_type,
+                               "URN of an auxiliary image, e.g. "
+                               "'urn:com:apple:photo:2020:aux:hdrgainmap'; empty otherwise.")
+        .def("get_gain_map", &HeifImageHandle::get_gain_map, py::keep_alive<0, 1>(),
+             "Handle of the HDR gain map stored as an auxiliary image, or None.")
         .def("get_metadata_block_ids", &HeifImageHandle::get_list_of_metadata_block_IDs,
              py::arg("type_filter") = "")
         .def("get_metadata_block_type", &HeifImageHandle::get_metadata_block_type)
-        .def("get_metadata_block", &HeifImageHandle::get_metadata_block);
+        .def("get_metadata_block", &HeifImageHandle::get_metadata_block)
+        .def("get_all_metadata", &HeifImageHandle::get_all_metadata, py::arg("type_filter") = "",
+             "Return every metadata block (Exif, XMP, ...) of the image in one call. The "
+             "payloads are read without the GIL straight into the returned bytes objects.");
+
+    py::class_<HeifPlane> plane(m, "HeifPlane", py::buffer_protocol());
+    plane.def_buffer(&HeifPlane::get_buffer_info);
+    def_tensor_exports(plane, [](py::object self) { return self.cast<HeifPlane&>().view(); });
 
-    py::class_<HeifPlane>(m, "HeifPlane", py::buffer_protocol())
-        .def_buffer(&HeifPlane::get_buffer_info);
+    py::class_<TensorView> tensor(m, "HeifTensor", py::buffer_protocol());
+    tensor
+        .def_property_readonly("shape",
+                               [](const TensorView& t) { return py::tuple(py::cast(t.shape)); })
+        .def_property_readonly("strides",
+                               [](const TensorView& t) { return py::tuple(py::cast(t.strides)); })
+        .def_readonly("readonly", &TensorView::readonly)
+        .def_readonly("copied", &TensorView::copied)
+        .def_buffer([](TensorView& t) {
+            PlaneLayout layout;
+            layout.bytes_per_channel = t.bytes_per_channel;
+            layout.byte_order = t.byte_order;
+            return py::buffer_info(t.data, t.bytes_per_channel, layout.format(),
+                                   static_cast<py::ssize_t>(t.shape.size()),
+                                   std::vector<py::ssize_t>(t.shape.begin(), t.shape.end()),
+                                   std::vector<py::ssize_t>(t.strides.begin(), t.strides.end()),
+                                   t.readonly);
+        });
+    def_tensor_exports(tensor, [](py::object self) { return self.cast<TensorView>(); });
 
-    py::class_<HeifImage, std::shared_ptr<HeifImage>>(m, "HeifImage", py::buffer_protocol())
-        .def(py::init<int, int, heif_colorspace, heif_chroma>())
+    py::class_<HeifImage, std::shared_ptr<HeifImage>> image_class(m, "HeifImage",
+                                                                   py::buffer_protocol());
+    image_class.def(py::init<int, int, heif_colorspace, heif_chroma>())
+        .def_property_readonly(
+            "as_array",
+            [](py::object self) -> py::object {
+                // Not cached: holding the view on the image would tie the pixels to the
+                // cycle collector. A view is cheap, as the plane layout is computed once.
+                HeifImage& img = self.cast<HeifImage&>();
+                heif_channel channel = heif_channel_interleaved;
+                if (!heif_image_has_channel(img.get(), channel)) {
+                    if (heif_image_get_chroma_format(img.get()) != heif_chroma_monochrome) {
+                        throw std::invalid_argument(
+                            "Planar images have no single array view; use get_plane()");
+                    }
+                    channel = heif_channel_Y;
+                }
+                py::buffer_info info = img.get_buffer_info(channel, true);
+                return py::array(py::dtype(info), info.shape, info.strides, info.ptr, self);
+            },
+            "Writable zero-copy numpy view of the interleaved (or monochrome) pixels.")
         .def_buffer([](HeifImage& img) -> py::buffer_info {
             return img.get_buffer_info(heif_channel_interleaved, true);
         })
         .def("get_width", &HeifImage::get_width)
         .def("get_height", &HeifImage::get_height)
+        .def("get_bits_per_pixel", &HeifImage::get_bits_per_pixel, py::arg("channel"),
+             "Significant bits per sample of a plane (e.g. 10 for HDR).")
+        .def("get_nclx_color_profile", &HeifImage::get_nclx_color_profile,
+             "NCLX color profile attached to the image, or None.")
         .def("add_plane", &HeifImage::add_plane)
+        .def_static("from_array", &HeifImage::from_array, py::arg("array"),
+                    py::arg("colorspace") = heif_colorspace_undefined,
+                    py::arg("chroma") = heif_chroma_undefined, py::arg("bit_depth") = 0,
+                    "Create an image from a (height, width[, channels]) uint8/uint16 array "
+                    "with a single copy that honours the array strides. Colorspace and "
+                    "chroma are inferred when left Undefined; bit_depth is required for "
+                    "uint16 arrays.")
         .def(
             "get_plane",
             [](std::shared_ptr<HeifImage> self, heif_channel channel, bool writeable) {
                 return HeifPlane(self, channel, writeable);
             },
-            py::arg("channel"), py::arg("writeable") = false);
+            py::arg("channel"), py::arg("writeable") = false)
+        .def(
+            "to_chw",
+            [](std::shared_ptr<HeifImage> self) { return chw_view(self); },
+            "(channels, height, width) HeifTensor of the color planes plus alpha. Interleaved "
+            "images give a strided view of their pixels; planar images with equally sized "
+            "planes (4:4:4, planar RGB, monochrome) are copied once.")
+        .def_property_readonly("premultiplied_alpha",
+                               [](const HeifImage& img) {
+                                   return heif_image_is_premultiplied_alpha(img.get()) != 0;
+                               })
+        .def(
+            "premultiply_alpha", [](HeifImage& img) { premultiply_alpha(img.get()); },
+            py::call_guard<py::gil_scoped_release>(),
+            "Multiply the colors of an interleaved RGBA image by its alpha, in place and "
+            "without the GIL. No-op if already premultiplied.")
+        .def(
+            "unpremultiply_alpha", [](HeifImage& img) { unpremultiply_alpha(img.get()); },
+            py::call_guard<py::gil_scoped_release>(),
+            "Divide the colors of a premultiplied interleaved RGBA image by its alpha, in "
+            "place and without the GIL. No-op if not premultiplied.")
+        .def("__reduce_ex__", &reduce_image, py::arg("protocol"),
+             "Pickle support. With protocol 5 the planes are PickleBuffers over the image "
+             "memory, so buffer_callback can send them out of band without a copy.");
+    m.def("_rebuild_image", &rebuild_image, py::arg("state"));
+    def_tensor_exports(image_class, [](py::object self) {
+        return image_view(self.cast<std::shared_ptr<HeifImage>>());
+    });
+
+    m.def(
+        "apply_gain_map",
+        [](const HeifImage& base, const HeifImage& gain_map, float gain_min, float gain_max,
+           float gamma, float offset_sdr, float offset_hdr, float weight) {
+            GainMapParams params{gain_min, gain_max, gamma, offset_sdr, offset_hdr, weight};
+            const int width = heif_image_get_primary_width(base.get());
+            const int height = heif_image_get_primary_height(base.get());
+            py::array_t<float> out({height, width, 3});
+            float* data = out.mutable_data();
+            {
+                py::gil_scoped_release release;
+                apply_gain_map(base.get(), gain_map.get(), params, data,
+                               static_cast<size_t>(width) * 3);
+            }
+            return out;
+        },
+        py::arg("base"), py::arg("gain_map"), py::arg("gain_min") = 0.f,
+        py::arg("gain_max") = 1.f, py::arg("gamma") = 1.f, py::arg("offset_sdr") = 1.f / 64,
+        py::arg("offset_hdr") = 1.f / 64, py::arg("weight") = 1.f,
+        "Apply an HDR gain map (log2 gain range gain_min..gain_max) to an sRGB RGB(A) base "
+        "image; returns a linear-light float32 (height, width, 3) array with SDR white at "
+        "1.0. The gain map is bilinearly upsampled; the work runs without the GIL.");
 
     py::class_<HeifEncoderDescriptor>(m, "HeifEncoderDescriptor")
         .def_property_readonly("id_name", &HeifEncoderDescriptor::id_name)
         .def_property_readonly("name", &HeifEncoderDescriptor::name)
         .def_property_readonly("compression_format", &HeifEncoderDescriptor::compression_format);
 
+    m.def("decode_batch", &decode_batch, py::arg("inputs"),
+          py::arg("colorspace") = heif_colorspace_RGB,
+          py::arg("chroma") = heif_chroma_interleaved_RGB, py::arg("threads") = 0,
+          py::arg("options") = nullptr, py::arg("max_decoding_threads") = -1,
+          py::arg("out") = py::none(), py::arg("cancel") = nullptr, py::arg("budget") = nullptr,
+          py::arg("security_limits") = nullptr,
+          "Decode the primary image of every path or buffer in `inputs` on `threads` native "
+          "workers (0 = one per core) without holding the GIL. Returns a list of HeifImage, "
+          "or fills `out` (an (N, height, width[, channels]) array) and returns it. With a "
+          "MemoryBudget, decodes start only once their estimated memory fits.");
+
+    m.def("encode_batch", &encode_batch, py::arg("images"),
+          py::arg("format") = heif_compression_HEVC, py::arg("quality") = -1,
+          py::arg("params") = py::dict(), py::arg("threads") = 0, py::arg("preset") = "",
+          py::arg("options") = nullptr, py::arg("paths") = py::none(),
+          py::arg("cancel") = nullptr,
+          "Encode each HeifImage into its own file on `threads` native workers (0 = one per "
+          "core). Every worker sets up one encoder with `quality` (-1 = encoder default), "
+          "`params` and `preset` and reuses it for all of its images. Returns a list of "
+          "bytes, or writes to `paths` and returns None.");
+
+    m.def("transcode", &transcode, py::arg("input"),
+          py::arg("output_format") = heif_compression_AV1, py::arg("max_size") = 0,
+          py::arg("quality") = -1, py::arg("params") = py::dict(),
+          py::arg("copy_metadata") = true, py::arg("options") = nullptr,
+          py::arg("cancel") = nullptr,
+          "Decode the primary image of a path or buffer, downscale it to fit into "
+          "max_size x max_size (0 = keep size) and re-encode it with output_format, without "
+          "the GIL and without exposing pixels to Python. Returns the encoded HEIF/AVIF file.");
+
+    py::class_<ProbeInfo>(m, "HeifProbeInfo")
+        .def_readonly("width", &ProbeInfo::width)
+        .def_readonly("height", &ProbeInfo::height)
+        .def_readonly("has_alpha", &ProbeInfo::has_alpha)
+        .def_readonly("luma_bits", &ProbeInfo::luma_bits)
+        .def_readonly("chroma_bits", &ProbeInfo::chroma_bits)
+        .def_readonly("num_images", &ProbeInfo::num_images)
+        .def_readonly("exif_orientation", &ProbeInfo::exif_orientation)
+        .def_readonly("bytes_read", &ProbeInfo::bytes_read)
+        .def("__repr__", [](const ProbeInfo& p) {
+            return "HeifProbeInfo(" + std::to_string(p.width) + "x" + std::to_string(p.height) +
+                   ", luma_bits=" + std::to_string(p.luma_bits) +
+                   ", has_alpha=" + (p.has_alpha ? "True" : "False") +
+                   ", num_images=" + std::to_string(p.num_images) + ")";
+        });
+
+    m.def("probe", &probe, py::arg("input"),
+          "Read dimensions, alpha, bit depths, image count and EXIF orientation of the "
+          "primary image from a path or buffer. Only the file structure is read, never the "
+          "coded image data.");
+    m.def("probe_batch", &probe_batch, py::arg("inputs"), py::arg("threads") = 0,
+          py::arg("raise_errors") = true,
+          "Probe many paths or buffers on `threads` native workers without the GIL. With "
+          "raise_errors=False, inputs that fail yield None.");
+
+    py::class_<ImagePoolStats>(m, "ImagePoolStats")
+        .def_readonly("enabled", &ImagePoolStats::enabled)
+        .def_readonly("max_bytes", &ImagePoolStats::max_bytes)
+        .def_readonly("pooled_bytes", &ImagePoolStats::pooled_bytes)
+        .def_readonly("pooled_images", &ImagePoolStats::pooled_images)
+        .def_readonly("hits", &ImagePoolStats::hits)
+        .def_readonly("misses", &ImagePoolStats::misses)
+        .def_readonly("returned", &ImagePoolStats::returned)
+        .def_readonly("rejected", &ImagePoolStats::rejected)
+        .def("__repr__", [](const ImagePoolStats& s) {
+            return "ImagePoolStats(enabled=" + std::string(s.enabled ? "True" : "False") +
+                   ", pooled_bytes=" + std::to_string(s.pooled_bytes) +
+                   ", hits=" + std::to_string(s.hits) + ", misses=" + std::to_string(s.misses) +
+                   ")";
+        });
+
+    m.def("enable_image_pool", &enable_image_pool, py::arg("max_bytes") = size_t(256) << 20,
+          "Recycle the pixel memory of images created by pylibheif (from_array, downscaled "
+          "and region decodes) up to max_bytes of idle images.");
+    m.def("disable_image_pool", &disable_image_pool, "Disable the image pool and free it.");
+    m.def("clear_image_pool", &clear_image_pool, "Free every idle pooled image.");
+    m.def("get_image_pool_stats", &get_image_pool_stats);
+
+    m.def("enable_stats", &enable_stats, py::arg("enabled") = true,
+          "Turn the process-wide per-stage timers and counters on or off (off by default).");
+    m.def("get_stats", &get_stats,
+          "Snapshot of the stats registry: per-stage calls, errors, total_ms, max_ms and "
+          "bytes, plus codec plugin use counts.");
+    m.def("reset_stats", &reset_stats, "Zero every stats counter.");
+
+    py::module_::import("atexit").attr("register")(py::cpp_function([]() {
+        for (const auto& weak : live_work_queues()) {
+            if (auto queue = weak.lock()) {
+                queue->shutdown(true, true);
+            }
+        }
+        live_work_queues().clear();
+    }));
+    py::class_<WorkQueue, std::shared_ptr<WorkQueue>>(m, "WorkQueue")
+        .def(py::init([](int threads) {
+                 auto queue = std::make_shared<WorkQueue>(threads);
+                 auto& queues = live_work_queues();
+                 queues.erase(std::remove_if(queues.begin(), queues.end(),
+                                             [](const auto& q) { return q.expired(); }),
+                              queues.end());
+                 queues.push_back(queue);
+                 return queue;
+             }),
+             py::arg("threads") = 0,
+             "Dedicated worker pool for the async API; threads=0 uses one worker per "
+             "hardware thread.")
+        .def("submit", &WorkQueue::submit, py::arg("loop"), py::arg("func"),
+             "Run func(*args, **kwargs) on a worker and return an asyncio future of loop.")
+        .def("shutdown", &WorkQueue::shutdown, py::arg("wait") = true,
+             py::arg("cancel_pending") = false)
+        .def_property_readonly("threads", &WorkQueue::get_threads)
+        .def_property_readonly("pending", &WorkQueue::get_pending)
+        .def_property_readonly("running", &WorkQueue::get_running)
+        .def_property_readonly("is_shutdown", &WorkQueue::is_shutdown)
+        .def("__enter__", [](std::shared_ptr<WorkQueue> self) { return self; })
+        .def("__exit__", [](WorkQueue& self, py::args) { self.shutdown(true, false); });
+
+    py::class_<MetadataBlock>(m, "HeifMetadataBlock")
+        .def_readonly("id", &MetadataBlock::id)
+        .def_readonly("type", &MetadataBlock::type)
+        .def_readonly("content_type", &MetadataBlock::content_type)
+        .def_readonly("data", &MetadataBlock::data)
+        .def("__repr__", [](const MetadataBlock& b) {
+            return "HeifMetadataBlock(id=" + std::to_string(b.id) + ", type='" + b.type +
+                   "', size=" + std::to_string(py::len(b.data)) + ")";
+        });
+
+    m.def("read_metadata_batch", &read_metadata_batch, py::arg("inputs"), py::arg("threads") = 0,
+          py::arg("type_filter") = "", py::arg("raise_errors") = true,
+          "Read every metadata block of the primary image of many paths or buffers on "
+          "`threads` native workers without the GIL. Image data is never read. Each file's "
+          "blocks are memoryviews into one shared buffer.");
+    m.def(
+        "edit_metadata",
+        [](const py::object& input, const py::object& output, std::optional<py::bytes> exif,
+           std::optional<py::bytes> xmp, const std::vector<std::string>& remove,
+           size_t padding, bool in_place) {
+            MetadataEdit edit;
+            if (exif) {
+                edit.exif = std::string(*exif);
+            }
+            if (xmp) {
+                edit.xmp = std::string(*xmp);
+            }
+            for (const std::string& kind : remove) {
+                if (kind == "exif") {
+                    edit.remove_exif = true;
+                } else if (kind == "xmp") {
+                    edit.remove_xmp = true;
+                } else {
+                    throw std::invalid_argument("remove entries must be 'exif' or 'xmp', got '" +
+                                                kind + "'");
+                }
+            }
+            edit.padding = padding;
+            return edit_metadata(input, output, edit, in_place);
+        },
+        py::arg("input"), py::arg("output") = py::none(), py::arg("exif") = py::none(),
+        py::arg("xmp") = py::none(), py::arg("remove") = std::vector<std::string>(),
+        py::arg("padding") = 0, py::arg("in_place") = false,
+        "Replace or remove the Exif/XMP of a still HEIF/AVIF file without decoding or copying "
+        "the image data through Python. Returns the new file as bytes, or None when writing to "
+        "`output` or editing `input` in place (which needs the room reserved by `padding`).");
+
+    py::class_<TargetEncoding>(m, "HeifTargetEncoding")
+        .def_readonly("data", &TargetEncoding::data)
+        .def_readonly("quality", &TargetEncoding::quality)
+        .def_readonly("score", &TargetEncoding::score)
+        .def_readonly("attempts", &TargetEncoding::attempts)
+        .def_readonly("reached", &TargetEncoding::reached)
+        .def("__repr__", [](const TargetEncoding& t) {
+            return "HeifTargetEncoding(quality=" + std::to_string(t.quality) +
+                   ", score=" + std::to_string(t.score) +
+                   ", attempts=" + std::to_string(t.attempts) +
+                   ", size=" + std::to_string(py::len(t.data)) + ")";
+        });
+
+    m.def("encode_to_target", &encode_to_target, py::arg("image"),
+          py::arg("format") = heif_compression_HEVC, py::arg("metric") = "ssim",
+          py::arg("target") = 0.98, py::arg("min_quality") = 0, py::arg("max_quality") = 100,
+          py::arg("max_attempts") = 8, py::arg("params") = py::dict(),
+          py::arg("options") = nullptr, py::arg("cancel") = nullptr,
+          "Encode with the lowest lossy quality whose decoded result reaches `target` "
+          "(metric 'ssim' or 'psnr' in dB) against the source. The quality is bisected in "
+          "native code with one reused encoder.");
+    m.def(
+        "compare_images",
+        [](const HeifImage& reference, const HeifImage& distorted, const std::string& metric) {
+            QualityMetric kind = parse_quality_metric(metric);
+            py::gil_scoped_release release;
+            return compare_images(reference.get(), distorted.get(), kind);
+        },
+        py::arg("reference"), py::arg("distorted"), py::arg("metric") = "ssim",
+        "SSIM or PSNR (dB) of the color planes of two images with the same size and chroma.");
+
     m.def("get_encoder_descriptors", &get_encoder_descriptors,
           py::arg("format_filter") = heif_compression_undefined, py::arg("name_filter") = "");
 
+    py::class_<NclxColorProfile>(m, "NclxColorProfile")
+        .def(py::init<>())
+        .def(py::init([](heif_color_primaries primaries, heif_transfer_characteristics transfer,
+                         heif_matrix_coefficients matrix, bool full_range) {
+                 return NclxColorProfile{primaries, transfer, matrix, full_range};
+             }),
+             py::arg("color_primaries"), py::arg("transfer_characteristics"),
+             py::arg("matrix_coefficients"), py::arg("full_range") = true)
+        .def_readwrite("color_primaries", &NclxColorProfile::color_primaries)
+        .def_readwrite("transfer_characteristics", &NclxColorProfile::transfer_characteristics)
+        .def_readwrite("matrix_coefficients", &NclxColorProfile::matrix_coefficients)
+        .def_readwrite("full_range", &NclxColorProfile::full_range)
+        .def("__repr__", [](const NclxColorProfile& p) {
+            return "NclxColorProfile(color_primaries=" +
+                   std::to_string(static_cast<int>(p.color_primaries)) +
+                   ", transfer_characteristics=" +
+                   std::to_string(static_cast<int>(p.transfer_characteristics)) +
+                   ", matrix_coefficients=" +
+                   std::to_string(static_cast<int>(p.matrix_coefficients)) +
+                   ", full_range=" + (p.full_range ? "True" : "False") + ")";
+        });
+
+    py::class_<EncodingOptions, std::shared_ptr<EncodingOptions>>(m, "EncodingOptions")
+        .def(py::init<>())
+        .def_property("save_alpha_channel", &EncodingOptions::get_save_alpha_channel,
+                      &EncodingOptions::set_save_alpha_channel)
+        .def_property("image_orientation", &EncodingOptions::get_image_orientation,
+                      &EncodingOptions::set_image_orientation,
+                      "Orientation written to the file; the pixels are not rotated.")
+        .def_property("chroma_downsampling", &EncodingOptions::get_chroma_downsampling,
+                      &EncodingOptions::set_chroma_downsampling)
+        .def_property("only_use_preferred_chroma_algorithm",
+                      &EncodingOptions::get_only_use_preferred_chroma_algorithm,
+                      &EncodingOptions::set_only_use_preferred_chroma_algorithm)
+        .def_property("output_nclx_profile", &EncodingOptions::get_output_nclx_profile,
+                      &EncodingOptions::set_output_nclx_profile,
+                      "NCLX color profile written to the file, or None for the default.")
+        .def_property("thumbnail_size", &EncodingOptions::get_thumbnail_size,
+                      &EncodingOptions::set_thumbnail_size,
+                      "Also encode a thumbnail fitting into this bounding box (0 = none).");
+
     py::class_<HeifEncoder, std::shared_ptr<HeifEncoder>>(m, "HeifEncoder")
         .def(py::init<heif_compression_format>())
         .def(py::init<HeifEncoderDescriptor>())
         .def_property_readonly("name", &HeifEncoder::name)
         .def("set_lossy_quality", &HeifEncoder::set_lossy_quality)
         .def("set_parameter", &HeifEncoder::set_parameter)
+        .def("list_parameters", &HeifEncoder::list_parameters)
+        .def_property("threads", &HeifEncoder::get_threads, &HeifEncoder::set_threads,
+                      "Codec worker threads; reads 0 until set (encoder default). Must be "
+                      ">= 1. Maps to 'threads' for aom/rav1e/SVT/OpenJPEG and to the x265 "
+                      "thread pool size.")
         .def("encode_image", &HeifEncoder::encode_image, py::arg("ctx"), py::arg("image"),
-             py::arg("preset") = "", py::call_guard<py::gil_scoped_release>());
+             py::arg("preset") = "", py::arg("options") = nullptr, py::arg("cancel") = nullptr,
+             py::call_guard<py::gil_scoped_release>());
 }
@@ -0,0 +1,114 @@
+#include "metadata.hpp"
+
+#include <pybind11/numpy.h>
+
+#include <exception>
+#include <optional>
+#include <vector>
+
+#include "batch.hpp"
+#include "reader.hpp"
+#include "thread_pool.hpp"
+
+namespace pylibheif {
+
+// A block located in the arena of its file
+struct BlockSpan {
+    heif_item_id id;
+    std::string type;
+    std::string content_type;
+    size_t offset;
+    size_t size;
+};
+
+struct FileMetadata {
+    std::vector<BlockSpan> blocks;
+    std::vector<uint8_t> arena;
+};
+
+// Reads all blocks of the primary image into one arena. Does not need the GIL.
+static FileMetadata read_file_metadata(ByteSource& source, const std::string& type_filter) {
+    ContextPtr ctx(heif_context_alloc());
+    check_error(heif_context_read_from_reader(ctx.get(), byte_source_reader(), &source, nullptr));
+
+    heif_image_handle* raw_handle;
+    check_error(heif_context_get_primary_image_handle(ctx.get(), &raw_handle));
+    HandlePtr handle(raw_handle);
+
+    const char* filter = type_filter.empty() ? nullptr : type_filter.c_str();
+    std::vector<heif_item_id> ids(
+        heif_image_handle_get_number_of_metadata_blocks(raw_handle, filter));
+    heif_image_handle_get_list_of_metadata_block_IDs(raw_handle, filter, ids.data(),
+                                                     static_cast<int>(ids.size()));
+
+    FileMetadata result;
+    size_t total = 0;
+    for (heif_item_id id : ids) {
+        const char* content_type = heif_image_handle_get_metadata_content_type(raw_handle, id);
+        const size_t size = heif_image_handle_get_metadata_size(raw_handle, id);
+        result.blocks.push_back({id, heif_image_handle_get_metadata_type(raw_handle, id),
+                                 content_type ? content_type : "", total, size});
+        total += size;
+    }
+
+    result.arena.resize(total);
+    for (const BlockSpan& block : result.blocks) {
+        check_error(heif_image_handle_get_metadata(raw_handle, block.id,
+                                                   result.arena.data() + block.offset));
+    }
+    return result;
+}
+
+// Hands the arena to a uint8 array and slices it into one memoryview per block
+static py::list to_blocks(FileMetadata& file) {
+    auto* arena = new std::vector<uint8_t>(std::move(file.arena));
+    py::capsule owner(arena, [](void* p) { delete static_cast<std::vector<uint8_t>*>(p); });
+    py::memoryview view(py::array_t<uint8_t>(static_cast<py::ssize_t>(arena->size()),
+                                             arena->data(), owner));
+
+    py::list result;
+    for (const BlockSpan& block : file.blocks) {
+        MetadataBlock out{block.id, block.type, block.content_type, {}};
+        out.data = view[py::slice(static_cast<py::ssize_t>(block.offset),
+                                  static_cast<py::ssize_t>(block.offset + block.size), 1)];
+        result.append(py::cast(std::move(out)));
+    }
+    return result;
+}
+
+py::list read_metadata_batch(const py::sequence& inputs, int threads,
+                             const std::string& type_filter, bool raise_errors) {
+    std::vector<BatchInput> items;
+    items.reserve(inputs.size());
+    for (auto item : inputs) {
+        items.push_back(resolve_input(item, "read_metadata_batch"));
+    }
+
+    std::vector<std::optional<FileMetadata>> results(items.size());
+    std::vector<std::exception_ptr> errors(items.size());
+    {
+        py::gil_scoped_release release;
+        parallel_for(items.size(), threads, [&](size_t i) {
+            try {
+                results[i] = read_file_metadata(*open_source(items[i]), type_filter);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+
+    if (raise_errors) {
+        for (auto& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+    py::list result;
+    for (auto& file : results) {
+        result.append(file ? py::object(to_blocks(*file)) : py::none());
+    }
+    return result;
+}
+
+}  // namespace pylibheif
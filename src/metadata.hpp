@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+
+#include "common.hpp"
+
+namespace pylibheif {
+
+// One Exif, XMP ("mime") or generic metadata block of an image
+struct MetadataBlock {
+    heif_item_id id = 0;
+    std::string type;          // Item type, e.g. "Exif" or "mime"
+    std::string content_type;  // e.g. "application/rdf+xml" for XMP; empty if unset
+    py::object data;           // bytes, or a memoryview into a per-file arena
+};
+
+// Every metadata block of the primary image of each input (paths or buffers), read on
+// `threads` native workers without the GIL. Files are read lazily, so the coded image data
+// is never touched. The blocks of one file share a single arena and are returned as
+// memoryview slices of it. With raise_errors=false, unreadable inputs yield None.
+py::list read_metadata_batch(const py::sequence& inputs, int threads,
+                             const std::string& type_filter, bool raise_errors);
+
+}  // namespace pylibheif
@@ -0,0 +1,1002 @@
+#include "metadata_edit.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "batch.hpp"
+#include "reader.hpp"
+
+namespace pylibheif {
+
+static constexpr uint32_t fourcc(const char (&s)[5]) {
+    return (uint32_t(uint8_t(s[0])) << 24) | (uint32_t(uint8_t(s[1])) << 16) |
+           (uint32_t(uint8_t(s[2])) << 8) | uint32_t(uint8_t(s[3]));
+}
+
+[[noreturn]] static void invalid_file(const std::string& message) {
+    heif_error err = {heif_error_Invalid_input, heif_suberror_Unspecified, message.c_str()};
+    throw HeifError(err);
+}
+
+[[noreturn]] static void unsupported_file(const std::string& message) {
+    heif_error err = {heif_error_Unsupported_feature, heif_suberror_Unspecified,
+                      message.c_str()};
+    throw HeifError(err);
+}
+
+static void read_exact(ByteSource& source, void* data, size_t size, uint64_t position) {
+    if (!source.read_at(data, size, static_cast<int64_t>(position))) {
+        throw std::runtime_error("Failed to read the input");
+    }
+}
+
+// Big-endian reader over one box; running past the end means the box is truncated
+class BoxReader {
+   public:
+    BoxReader(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+    uint64_t read(int bytes) {
+        need(bytes);
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; ++i) {
+            value = (value << 8) | data[pos++];
+        }
+        return value;
+    }
+    uint32_t u8() { return static_cast<uint32_t>(read(1)); }
+    uint32_t u16() { return static_cast<uint32_t>(read(2)); }
+    uint32_t u32() { return static_cast<uint32_t>(read(4)); }
+    // Null-terminated; an unterminated string ends with the box
+    std::string string() {
+        size_t end = pos;
+        while (end < size && data[end]) {
+            ++end;
+        }
+        std::string value(reinterpret_cast<const char*>(data + pos), end - pos);
+        pos = std::min(size, end + 1);
+        return value;
+    }
+    void skip(size_t bytes) {
+        need(bytes);
+        pos += bytes;
+    }
+
+    size_t position() const { return pos; }
+    size_t remaining() const { return size - pos; }
+    const uint8_t* current() const { return data + pos; }
+
+   private:
+    const uint8_t* data;
+    size_t size;
+    size_t pos = 0;
+
+    void need(size_t bytes) const {
+        if (bytes > size - pos) {
+            invalid_file("Truncated box in the meta box");
+        }
+    }
+};
+
+class BoxWriter {
+   public:
+    void write(uint64_t value, int bytes) {
+        for (int i = bytes - 1; i >= 0; --i) {
+            out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+    void bytes(const void* data, size_t size) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        out.insert(out.end(), p, p + size);
+    }
+    void string(const std::string& value) {
+        bytes(value.data(), value.size());
+        out.push_back(0);
+    }
+    size_t begin_box(uint32_t type) {
+        const size_t start = out.size();
+        write(0, 4);
+        write(type, 4);
+        return start;
+    }
+    size_t begin_full_box(uint32_t type, uint32_t version, uint32_t flags) {
+        const size_t start = begin_box(type);
+        write(version, 1);
+        write(flags, 3);
+        return start;
+    }
+    void end_box(size_t start) {
+        const uint64_t size = out.size() - start;
+        if (size > UINT32_MAX) {
+            unsupported_file("Rewritten box exceeds 4 GiB");
+        }
+        for (int i = 0; i < 4; ++i) {
+            out[start + i] = static_cast<uint8_t>(size >> (8 * (3 - i)));
+        }
+    }
+
+    std::vector<uint8_t> out;
+};
+
+struct ChildBox {
+    uint32_t type;
+    const uint8_t* data;  // Start of the box, header included
+    size_t size;
+    size_t header;
+};
+
+static std::vector<ChildBox> parse_children(const uint8_t* data, size_t size) {
+    std::vector<ChildBox> boxes;
+    size_t pos = 0;
+    while (pos < size) {
+        BoxReader r(data + pos, size - pos);
+        uint64_t box_size = r.u32();
+        const uint32_t type = r.u32();
+        size_t header = 8;
+        if (box_size == 1) {
+            box_size = r.read(8);
+            header = 16;
+        } else if (box_size == 0) {
+            box_size = size - pos;
+        }
+        if (type == fourcc("uuid")) {
+            header += 16;
+        }
+        if (box_size < header || box_size > size - pos) {
+            invalid_file("Invalid box size in the meta box");
+        }
+        boxes.push_back({type, data + pos, static_cast<size_t>(box_size), header});
+        pos += box_size;
+    }
+    return boxes;
+}
+
+struct TopLevelBox {
+    uint32_t type;
+    uint64_t offset;
+    uint64_t size;
+    bool to_end;  // Size 0 in the file: the box runs to the end of the file
+};
+
+// Reads only the box headers of the file
+static std::vector<TopLevelBox> scan_top_level(ByteSource& source) {
+    const uint64_t file_size = static_cast<uint64_t>(source.size());
+    std::vector<TopLevelBox> boxes;
+    uint64_t pos = 0;
+    while (pos < file_size) {
+        if (file_size - pos < 8) {
+            invalid_file("Truncated box header");
+        }
+        uint8_t header[16];
+        read_exact(source, header, 8, pos);
+        BoxReader r(header, 8);
+        TopLevelBox box{0, pos, r.u32(), false};
+        box.type = r.u32();
+        if (box.size == 1) {
+            if (file_size - pos < 16) {
+                invalid_file("Truncated box header");
+            }
+            read_exact(source, header + 8, 8, pos + 8);
+            box.size = BoxReader(header + 8, 8).read(8);
+        } else if (box.size == 0) {
+            box.size = file_size - pos;
+            box.to_end = true;
+        }
+        if (box.size < 8 || box.size > file_size - pos) {
+            invalid_file("Invalid top-level box size");
+        }
+        boxes.push_back(box);
+        pos += box.size;
+    }
+    return boxes;
+}
+
+struct Extent {
+    uint64_t index = 0;
+    uint64_t offset = 0;
+    uint64_t length = 0;
+};
+
+struct ItemLocation {
+    uint32_t item_id = 0;
+    uint32_t construction_method = 0;  // 0 = file offset, 1 = idat, 2 = another item
+    uint32_t data_reference_index = 0;
+    uint64_t base_offset = 0;
+    std::vector<Extent> extents;
+
+    // Extents are absolute file offsets, the only ones that move with the meta box
+    bool in_file() const { return construction_method == 0 && data_reference_index == 0; }
+};
+
+struct ItemLocations {
+    uint32_t version = 0;
+    int offset_size = 0;
+    int length_size = 0;
+    int base_offset_size = 0;
+    int index_size = 0;
+    std::vector<ItemLocation> items;
+};
+
+static ItemLocations parse_iloc(const ChildBox& box) {
+    BoxReader r(box.data + box.header, box.size - box.header);
+    ItemLocations iloc;
+    iloc.version = r.u8();
+    r.skip(3);
+    if (iloc.version > 2) {
+        unsupported_file("Unsupported iloc version");
+    }
+    uint32_t sizes = r.u8();
+    iloc.offset_size = sizes >> 4;
+    iloc.length_size = sizes & 15;
+    sizes = r.u8();
+    iloc.base_offset_size = sizes >> 4;
+    iloc.index_size = iloc.version >= 1 ? (sizes & 15) : 0;
+    for (int size : {iloc.offset_size, iloc.length_size, iloc.base_offset_size, iloc.index_size}) {
+        if (size != 0 && size != 4 && size != 8) {
+            invalid_file("Invalid iloc field size");
+        }
+    }
+
+    const uint32_t count = iloc.version < 2 ? r.u16() : r.u32();
+    for (uint32_t i = 0; i < count; ++i) {
+        ItemLocation item;
+        item.item_id = iloc.version < 2 ? r.u16() : r.u32();
+        if (iloc.version >= 1) {
+            item.construction_method = r.u16() & 15;
+        }
+        item.data_reference_index = r.u16();
+        item.base_offset = r.read(iloc.base_offset_size);
+        const uint32_t extents = r.u16();
+        for (uint32_t e = 0; e < extents; ++e) {
+            Extent extent;
+            extent.index = r.read(iloc.index_size);
+            extent.offset = r.read(iloc.offset_size);
+            extent.length = r.read(iloc.length_size);
+            item.extents.push_back(extent);
+        }
+        iloc.items.push_back(std::move(item));
+    }
+    return iloc;
+}
+
+struct ItemInfo {
+    uint32_t item_id = 0;
+    uint32_t type = 0;
+    std::string content_type;
+    const uint8_t* raw = nullptr;  // The original infe box, copied as is when kept
+    size_t raw_size = 0;
+};
+
+static std::vector<ItemInfo> parse_iinf(const ChildBox& box, uint32_t& version) {
+    BoxReader r(box.data + box.header, box.size - box.header);
+    version = r.u8();
+    r.skip(3);
+    r.skip(version == 0 ? 2 : 4);  // entry_count; the infe boxes are counted instead
+
+    std::vector<ItemInfo> items;
+    for (const ChildBox& child : parse_children(r.current(), r.remaining())) {
+        if (child.type != fourcc("infe")) {
+            continue;
+        }
+        BoxReader e(child.data + child.header, child.size - child.header);
+        const uint32_t infe_version = e.u8();
+        e.skip(3);
+        ItemInfo info;
+        info.raw = child.data;
+        info.raw_size = child.size;
+        if (infe_version < 2) {
+            info.item_id = e.u16();
+        } else {
+            info.item_id = infe_version == 2 ? e.u16() : e.u32();
+            e.skip(2);  // item_protection_index
+            info.type = e.u32();
+            e.string();  // item_name
+            if (info.type == fourcc("mime")) {
+                info.content_type = e.string();
+            }
+        }
+        items.push_back(std::move(info));
+    }
+    return items;
+}
+
+struct ItemReference {
+    uint32_t type;
+    uint32_t from;
+    std::vector<uint32_t> to;
+};
+
+static std::vector<ItemReference> parse_iref(const ChildBox& box, uint32_t& version) {
+    BoxReader r(box.data + box.header, box.size - box.header);
+    version = r.u8();
+    r.skip(3);
+    std::vector<ItemReference> refs;
+    for (const ChildBox& child : parse_children(r.current(), r.remaining())) {
+        BoxReader c(child.data + child.header, child.size - child.header);
+        ItemReference ref{child.type, version == 0 ? c.u16() : c.u32(), {}};
+        const uint32_t count = c.u16();
+        for (uint32_t i = 0; i < count; ++i) {
+            ref.to.push_back(version == 0 ? c.u16() : c.u32());
+        }
+        refs.push_back(std::move(ref));
+    }
+    return refs;
+}
+
+static uint32_t parse_pitm(const ChildBox& box) {
+    BoxReader r(box.data + box.header, box.size - box.header);
+    const uint32_t version = r.u8();
+    r.skip(3);
+    return version == 0 ? r.u16() : r.u32();
+}
+
+// Copies an ipma box without the entries of `deleted`; returns false if nothing was dropped
+static bool rewrite_ipma(const ChildBox& box, const std::set<uint32_t>& deleted,
+                         BoxWriter& w) {
+    BoxReader r(box.data + box.header, box.size - box.header);
+    const uint32_t version = r.u8();
+    const uint32_t flags = static_cast<uint32_t>(r.read(3));
+    const uint32_t count = r.u32();
+
+    std::vector<std::pair<size_t, size_t>> kept;  // Byte spans of the kept entries
+    for (uint32_t i = 0; i < count; ++i) {
+        const size_t start = r.position();
+        const uint32_t item_id = version < 1 ? r.u16() : r.u32();
+        const uint32_t associations = r.u8();
+        r.skip(associations * ((flags & 1) ? 2 : 1));
+        if (!deleted.count(item_id)) {
+            kept.emplace_back(start, r.position() - start);
+        }
+    }
+    if (kept.size() == count) {
+        return false;
+    }
+    const uint8_t* payload = box.data + box.header;
+    const size_t start = w.begin_full_box(fourcc("ipma"), version, flags);
+    w.write(kept.size(), 4);
+    for (const auto& span : kept) {
+        w.bytes(payload + span.first, span.second);
+    }
+    w.end_box(start);
+    return true;
+}
+
+// Byte range of the input replaced or patched in the output; empty data means zeros
+struct Patch {
+    uint64_t offset;
+    uint64_t length;
+    std::vector<uint8_t> data;
+};
+
+struct EditPlan {
+    uint64_t input_size = 0;
+    // The old meta box plus the free boxes right after it, replaced by `region`
+    uint64_t region_start = 0;
+    uint64_t region_end = 0;
+    std::vector<uint8_t> region;
+    std::vector<Patch> patches;    // Input coordinates, outside the region
+    std::vector<uint8_t> trailer;  // 'mdat' with the new payloads, appended to the file
+
+    uint64_t output_size() const {
+        return input_size - (region_end - region_start) + region.size() + trailer.size();
+    }
+};
+
+struct NewItem {
+    uint32_t item_id;
+    uint32_t type;
+    std::string content_type;
+    std::vector<uint8_t> payload;
+};
+
+static constexpr const char* kXmpContentType = "application/rdf+xml";
+
+// Exif items start with the offset of the TIFF header, found the same way libheif does
+static std::vector<uint8_t> exif_payload(const std::string& exif) {
+    size_t offset = std::string::npos;
+    for (size_t i = 0; i + 4 <= exif.size(); ++i) {
+        if (exif.compare(i, 4, std::string("MM\0*", 4)) == 0 ||
+            exif.compare(i, 4, std::string("II*\0", 4)) == 0) {
+            offset = i;
+            break;
+        }
+    }
+    if (offset == std::string::npos) {
+        throw std::invalid_argument("exif data has no TIFF header (II*\\0 or MM\\0*)");
+    }
+    BoxWriter w;
+    w.write(offset, 4);
+    w.bytes(exif.data(), exif.size());
+    return std::move(w.out);
+}
+
+static bool fits(uint64_t value, int bytes) {
+    return bytes >= 8 || value < (uint64_t(1) << (8 * bytes));
+}
+
+// Picks the narrowest iloc field size that keeps the original layout valid
+static int widened(int original, bool needs_value, uint64_t bound) {
+    if (original == 0 && !needs_value) {
+        return 0;
+    }
+    const int needed = fits(bound, 4) ? 4 : 8;
+    return std::max(original, needed);
+}
+
+static EditPlan plan_edit(ByteSource& source, const MetadataEdit& edit, bool in_place) {
+    EditPlan plan;
+    plan.input_size = static_cast<uint64_t>(source.size());
+
+    const std::vector<TopLevelBox> boxes = scan_top_level(source);
+    size_t meta_index = boxes.size();
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        if (boxes[i].type == fourcc("moov") || boxes[i].type == fourcc("moof")) {
+            unsupported_file("Files with tracks (moov) cannot be edited in place");
+        }
+        if (boxes[i].type == fourcc("meta")) {
+            if (meta_index != boxes.size()) {
+                invalid_file("More than one top-level meta box");
+            }
+            meta_index = i;
+        }
+    }
+    if (meta_index == boxes.size()) {
+        invalid_file("No top-level meta box");
+    }
+    const TopLevelBox& meta_box = boxes[meta_index];
+    plan.region_start = meta_box.offset;
+    plan.region_end = meta_box.offset + meta_box.size;
+    size_t after_region = meta_index + 1;
+    while (after_region < boxes.size() && (boxes[after_region].type == fourcc("free") ||
+                                           boxes[after_region].type == fourcc("skip"))) {
+        plan.region_end = boxes[after_region].offset + boxes[after_region].size;
+        ++after_region;
+    }
+
+    std::vector<uint8_t> meta_data(static_cast<size_t>(meta_box.size));
+    read_exact(source, meta_data.data(), meta_data.size(), meta_box.offset);
+    const ChildBox meta = parse_children(meta_data.data(), meta_data.size()).at(0);
+    BoxReader meta_reader(meta.data + meta.header, meta.size - meta.header);
+    const uint32_t meta_version = meta_reader.u8();
+    const uint32_t meta_flags = static_cast<uint32_t>(meta_reader.read(3));
+    const std::vector<ChildBox> children =
+        parse_children(meta_reader.current(), meta_reader.remaining());
+
+    const ChildBox* pitm = nullptr;
+    const ChildBox* iloc_box = nullptr;
+    const ChildBox* iinf_box = nullptr;
+    const ChildBox* iref_box = nullptr;
+    const ChildBox* idat_box = nullptr;
+    for (const ChildBox& child : children) {
+        if (child.type == fourcc("pitm")) {
+            pitm = &child;
+        } else if (child.type == fourcc("iloc")) {
+            iloc_box = &child;
+        } else if (child.type == fourcc("iinf")) {
+            iinf_box = &child;
+        } else if (child.type == fourcc("iref")) {
+            iref_box = &child;
+        } else if (child.type == fourcc("idat")) {
+            idat_box = &child;
+        }
+    }
+    if (!pitm || !iloc_box || !iinf_box) {
+        invalid_file("The meta box lacks pitm, iloc or iinf");
+    }
+
+    const uint32_t primary = parse_pitm(*pitm);
+    ItemLocations iloc = parse_iloc(*iloc_box);
+    uint32_t iinf_version = 0;
+    const std::vector<ItemInfo> infos = parse_iinf(*iinf_box, iinf_version);
+    uint32_t iref_version = 0;
+    std::vector<ItemReference> refs;
+    if (iref_box) {
+        refs = parse_iref(*iref_box, iref_version);
+    }
+
+    // Every block of a replaced or removed kind goes, whichever image it describes
+    const bool drop_exif = edit.remove_exif || edit.exif.has_value();
+    const bool drop_xmp = edit.remove_xmp || edit.xmp.has_value();
+    std::set<uint32_t> deleted;
+    uint32_t max_id = primary;
+    for (const ItemInfo& info : infos) {
+        max_id = std::max(max_id, info.item_id);
+        const bool exif = info.type == fourcc("Exif");
+        const bool xmp = info.type == fourcc("mime") && info.content_type == kXmpContentType;
+        if (info.item_id != primary && ((drop_exif && exif) || (drop_xmp && xmp))) {
+            deleted.insert(info.item_id);
+        }
+    }
+    for (const ItemLocation& item : iloc.items) {
+        max_id = std::max(max_id, item.item_id);
+    }
+
+    std::vector<NewItem> new_items;
+    if (edit.exif) {
+        new_items.push_back({++max_id, fourcc("Exif"), "", exif_payload(*edit.exif)});
+    }
+    if (edit.xmp) {
+        new_items.push_back({++max_id, fourcc("mime"), kXmpContentType,
+                             std::vector<uint8_t>(edit.xmp->begin(), edit.xmp->end())});
+    }
+    uint64_t payload_bytes = 0;
+    for (const NewItem& item : new_items) {
+        payload_bytes += item.payload.size();
+    }
+    const uint64_t trailer_size = new_items.empty() ? 0 : 8 + payload_bytes;
+    if (trailer_size > UINT32_MAX) {
+        throw std::invalid_argument("New metadata exceeds 4 GiB");
+    }
+
+    // Item data may sit before or after the region, which is the only part that moves
+    auto overlaps_region = [&](uint64_t offset, uint64_t length) {
+        return offset < plan.region_end &&
+               offset + std::max<uint64_t>(length, 1) > plan.region_start;
+    };
+    std::vector<std::pair<uint64_t, uint64_t>> kept_ranges;
+    size_t extent_count = 0;
+    for (const ItemLocation& item : iloc.items) {
+        extent_count += item.extents.size();
+        if (!item.in_file() || deleted.count(item.item_id)) {
+            continue;
+        }
+        for (const Extent& extent : item.extents) {
+            const uint64_t offset = item.base_offset + extent.offset;
+            if (overlaps_region(offset, extent.length)) {
+                unsupported_file("Item data inside the meta box cannot be moved");
+            }
+            kept_ranges.emplace_back(offset, extent.length);
+        }
+    }
+
+    // Scrub the payloads of deleted items unless another item shares the bytes
+    std::vector<uint8_t> idat;
+    if (idat_box) {
+        idat.assign(idat_box->data + idat_box->header, idat_box->data + idat_box->size);
+    }
+    for (const ItemLocation& item : iloc.items) {
+        if (!deleted.count(item.item_id)) {
+            continue;
+        }
+        for (const Extent& extent : item.extents) {
+            const uint64_t offset = item.base_offset + extent.offset;
+            if (item.construction_method == 1 && offset < idat.size()) {
+                std::fill_n(idat.begin() + offset,
+                            std::min<uint64_t>(extent.length, idat.size() - offset), 0);
+            } else if (item.in_file() && extent.length > 0 &&
+                       !overlaps_region(offset, extent.length)) {
+                const bool shared = std::any_of(
+                    kept_ranges.begin(), kept_ranges.end(), [&](const auto& range) {
+                        return range.first < offset + extent.length &&
+                               offset < range.first + std::max<uint64_t>(range.second, 1);
+                    });
+                if (!shared) {
+                    plan.patches.push_back({offset, extent.length, {}});
+                }
+            }
+        }
+    }
+
+    // A last box that runs to the end of the file needs an explicit size before the trailer
+    if (!new_items.empty() && boxes.back().to_end && boxes.back().offset >= plan.region_end) {
+        if (!fits(boxes.back().size, 4)) {
+            unsupported_file("Cannot append metadata after a box of more than 4 GiB");
+        }
+        BoxWriter size;
+        size.write(boxes.back().size, 4);
+        plan.patches.push_back({boxes.back().offset, 4, std::move(size.out)});
+    }
+
+    // Field sizes are fixed from an upper bound of every file offset, so the meta box has the
+    // same size whatever shift the offsets end up with
+    const uint64_t offset_bound = plan.input_size + meta_box.size + edit.padding + trailer_size +
+                                  65536 + 32 * (extent_count + new_items.size());
+    uint32_t iloc_version = iloc.version;
+    uint32_t ref_version = iref_box ? iref_version : 0;
+    if (max_id > 0xFFFF) {
+        iloc_version = 2;
+        ref_version = 1;
+        iinf_version = std::max<uint32_t>(iinf_version, 1);
+    }
+    const bool new_in_base = !new_items.empty() && iloc.base_offset_size > 0;
+    bool any_base = new_in_base;
+    uint64_t max_length = payload_bytes;
+    for (const ItemLocation& item : iloc.items) {
+        any_base |= item.base_offset != 0;
+        for (const Extent& extent : item.extents) {
+            max_length = std::max(max_length, extent.length);
+        }
+    }
+    const int base_offset_size = widened(iloc.base_offset_size, any_base, offset_bound);
+    const int offset_size =
+        widened(iloc.offset_size, !new_items.empty() && !new_in_base, offset_bound);
+    const int length_size = widened(iloc.length_size, !new_items.empty(), max_length);
+    const int index_size = iloc_version >= 1 ? iloc.index_size : 0;
+
+    auto build_meta = [&](int64_t delta, uint64_t trailer_start) {
+        auto shift = [&](uint64_t offset) {
+            return offset >= plan.region_end ? offset + delta : offset;
+        };
+        BoxWriter w;
+        const size_t meta_start = w.begin_full_box(fourcc("meta"), meta_version, meta_flags);
+        bool wrote_iref = false;
+        auto write_iref = [&] {
+            std::vector<ItemReference> kept;
+            for (const ItemReference& ref : refs) {
+                if (deleted.count(ref.from)) {
+                    continue;
+                }
+                ItemReference copy{ref.type, ref.from, {}};
+                for (uint32_t to : ref.to) {
+                    if (!deleted.count(to)) {
+                        copy.to.push_back(to);
+                    }
+                }
+                if (!copy.to.empty()) {
+                    kept.push_back(std::move(copy));
+                }
+            }
+            for (const NewItem& item : new_items) {
+                kept.push_back({fourcc("cdsc"), item.item_id, {primary}});
+            }
+            if (!kept.empty()) {
+                const int id_size = ref_version == 0 ? 2 : 4;
+                const size_t start = w.begin_full_box(fourcc("iref"), ref_version, 0);
+                for (const ItemReference& ref : kept) {
+                    const size_t entry = w.begin_box(ref.type);
+                    w.write(ref.from, id_size);
+                    w.write(ref.to.size(), 2);
+                    for (uint32_t to : ref.to) {
+                        w.write(to, id_size);
+                    }
+                    w.end_box(entry);
+                }
+                w.end_box(start);
+            }
+            wrote_iref = true;
+        };
+
+        for (const ChildBox& child : children) {
+            if (&child == iloc_box) {
+                const size_t start = w.begin_full_box(fourcc("iloc"), iloc_version, 0);
+                w.write((offset_size << 4) | length_size, 1);
+                w.write((base_offset_size << 4) | index_size, 1);
+                uint32_t count = static_cast<uint32_t>(new_items.size());
+                for (const ItemLocation& item : iloc.items) {
+                    count += deleted.count(item.item_id) ? 0 : 1;
+                }
+                w.write(count, iloc_version < 2 ? 2 : 4);
+
+                auto write_item = [&](uint32_t id, const ItemLocation& item, uint64_t base,
+                                      const std::vector<Extent>& extents) {
+                    w.write(id, iloc_version < 2 ? 2 : 4);
+                    if (iloc_version >= 1) {
+                        w.write(item.construction_method, 2);
+                    }
+                    w.write(item.data_reference_index, 2);
+                    w.write(base, base_offset_size);
+                    w.write(extents.size(), 2);
+                    for (const Extent& extent : extents) {
+                        w.write(extent.index, index_size);
+                        w.write(extent.offset, offset_size);
+                        w.write(extent.length, length_size);
+                    }
+                };
+                for (const ItemLocation& item : iloc.items) {
+                    if (deleted.count(item.item_id)) {
+                        continue;
+                    }
+                    uint64_t base = item.base_offset;
+                    std::vector<Extent> extents = item.extents;
+                    if (item.in_file()) {
+                        // Moving the base moves every extent at once; otherwise (no base
+                        // field, or extents on both sides of the region) each extent moves
+                        const bool after = !extents.empty() &&
+                                           std::all_of(extents.begin(), extents.end(),
+                                                       [&](const Extent& extent) {
+                                                           return base + extent.offset >=
+                                                                  plan.region_end;
+                                                       });
+                        if (base_offset_size > 0 && after) {
+                            base += delta;
+                        } else {
+                            for (Extent& extent : extents) {
+                                extent.offset = shift(base + extent.offset) - base;
+                            }
+                        }
+                    }
+                    write_item(item.item_id, item, base, extents);
+                }
+                uint64_t payload_offset = trailer_start + 8;
+                for (const NewItem& item : new_items) {
+                    const uint64_t length = item.payload.size();
+                    if (new_in_base) {
+                        write_item(item.item_id, ItemLocation(), payload_offset, {{0, 0, length}});
+                    } else {
+                        write_item(item.item_id, ItemLocation(), 0, {{0, payload_offset, length}});
+                    }
+                    payload_offset += length;
+                }
+                w.end_box(start);
+            } else if (&child == iinf_box) {
+                const size_t start = w.begin_full_box(fourcc("iinf"), iinf_version, 0);
+                uint32_t count = static_cast<uint32_t>(new_items.size());
+                for (const ItemInfo& info : infos) {
+                    count += deleted.count(info.item_id) ? 0 : 1;
+                }
+                w.write(count, iinf_version == 0 ? 2 : 4);
+                for (const ItemInfo& info : infos) {
+                    if (!deleted.count(info.item_id)) {
+                        w.bytes(info.raw, info.raw_size);
+                    }
+                }
+                for (const NewItem& item : new_items) {
+                    // Hidden like libheif's own metadata items
+                    const uint32_t version = item.item_id > 0xFFFF ? 3 : 2;
+                    const size_t infe = w.begin_full_box(fourcc("infe"), version, 1);
+                    w.write(item.item_id, version == 2 ? 2 : 4);
+                    w.write(0, 2);
+                    w.write(item.type, 4);
+                    w.string("");
+                    if (item.type == fourcc("mime")) {
+                        w.string(item.content_type);
+                    }
+                    w.end_box(infe);
+                }
+                w.end_box(start);
+                if (!iref_box) {
+                    write_iref();
+                }
+            } else if (&child == iref_box) {
+                write_iref();
+            } else if (child.type == fourcc("iprp") && !deleted.empty()) {
+                const size_t start = w.begin_box(fourcc("iprp"));
+                for (const ChildBox& property : parse_children(child.data + child.header,
+                                                               child.size - child.header)) {
+                    if (property.type != fourcc("ipma") ||
+                        !rewrite_ipma(property, deleted, w)) {
+                        w.bytes(property.data, property.size);
+                    }
+                }
+                w.end_box(start);
+            } else if (&child == idat_box) {
+                const size_t start = w.begin_box(fourcc("idat"));
+                w.bytes(idat.data(), idat.size());
+                w.end_box(start);
+            } else {
+                w.bytes(child.data, child.size);
+            }
+        }
+        if (!wrote_iref) {
+            write_iref();
+        }
+        w.end_box(meta_start);
+        return std::move(w.out);
+    };
+
+    // The meta size does not depend on the shift, so a first build measures it
+    const uint64_t old_region = plan.region_end - plan.region_start;
+    const uint64_t meta_size = build_meta(0, 0).size();
+    uint64_t padding = edit.padding;
+    if (in_place) {
+        if (meta_size > old_region) {
+            throw std::invalid_argument(
+                "The new meta box is " + std::to_string(meta_size - old_region) +
+                " bytes larger than the space in the file; rewrite it once with padding=");
+        }
+        padding = old_region - meta_size;
+    }
+    if (padding != 0 && padding < 8) {
+        throw std::invalid_argument(in_place ? "The new meta box leaves a gap of less than 8 "
+                                               "bytes, too small for a free box"
+                                             : "padding must be 0 or at least 8 bytes");
+    }
+    const int64_t delta = static_cast<int64_t>(meta_size + padding) -
+                          static_cast<int64_t>(old_region);
+    const uint64_t trailer_start = plan.input_size + delta;
+
+    plan.region = build_meta(delta, trailer_start);
+    if (padding > 0) {
+        if (!fits(padding, 4)) {
+            throw std::invalid_argument("padding must be below 4 GiB");
+        }
+        BoxWriter free;
+        free.write(padding, 4);
+        free.write(fourcc("free"), 4);
+        plan.region.insert(plan.region.end(), free.out.begin(), free.out.end());
+        plan.region.resize(plan.region.size() + padding - 8, 0);
+    }
+
+    if (!new_items.empty()) {
+        BoxWriter trailer;
+        trailer.write(trailer_size, 4);
+        trailer.write(fourcc("mdat"), 4);
+        for (const NewItem& item : new_items) {
+            trailer.bytes(item.payload.data(), item.payload.size());
+        }
+        plan.trailer = std::move(trailer.out);
+    }
+    return plan;
+}
+
+class ByteSink {
+   public:
+    virtual ~ByteSink() = default;
+    virtual void write(const uint8_t* data, size_t size) = 0;
+};
+
+class MemorySink : public ByteSink {
+   public:
+    MemorySink(uint8_t* data, size_t capacity) : data(data), capacity(capacity) {}
+    void write(const uint8_t* bytes, size_t size) override {
+        if (size > capacity - used) {
+            throw std::logic_error("edit_metadata wrote past the planned size");
+        }
+        std::memcpy(data + used, bytes, size);
+        used += size;
+    }
+
+   private:
+    uint8_t* data;
+    size_t capacity;
+    size_t used = 0;
+};
+
+class FileSink : public ByteSink {
+   public:
+    FileSink(FILE* file, const std::string& path) : file(file), path(path) {}
+    void write(const uint8_t* data, size_t size) override {
+        if (std::fwrite(data, 1, size, file) != size) {
+            throw std::runtime_error("Failed to write " + path);
+        }
+    }
+
+   private:
+    FILE* file;
+    const std::string& path;
+};
+
+static void apply_patches(const EditPlan& plan, uint64_t position, uint8_t* data, size_t size) {
+    for (const Patch& patch : plan.patches) {
+        const uint64_t start = std::max(position, patch.offset);
+        const uint64_t end = std::min(position + size, patch.offset + patch.length);
+        if (start >= end) {
+            continue;
+        }
+        if (patch.data.empty()) {
+            std::memset(data + (start - position), 0, end - start);
+        } else {
+            std::memcpy(data + (start - position), patch.data.data() + (start - patch.offset),
+                        end - start);
+        }
+    }
+}
+
+// Streams [from, to) of the input through a bounded buffer
+static void copy_range(ByteSource& source, const EditPlan& plan, uint64_t from, uint64_t to,
+                       ByteSink& sink) {
+    std::vector<uint8_t> buffer(static_cast<size_t>(std::min<uint64_t>(to - from, 1 << 20)));
+    for (uint64_t pos = from; pos < to;) {
+        const size_t n = static_cast<size_t>(std::min<uint64_t>(buffer.size(), to - pos));
+        read_exact(source, buffer.data(), n, pos);
+        apply_patches(plan, pos, buffer.data(), n);
+        sink.write(buffer.data(), n);
+        pos += n;
+    }
+}
+
+static void write_edited(ByteSource& source, const EditPlan& plan, ByteSink& sink) {
+    copy_range(source, plan, 0, plan.region_start, sink);
+    sink.write(plan.region.data(), plan.region.size());
+    copy_range(source, plan, plan.region_end, plan.input_size, sink);
+    sink.write(plan.trailer.data(), plan.trailer.size());
+}
+
+using FilePtr = std::unique_ptr<FILE, int (*)(FILE*)>;
+
+static FilePtr open_file(const std::string& path, const char* mode) {
+    FilePtr file(std::fopen(path.c_str(), mode), &std::fclose);
+    if (!file) {
+        throw std::runtime_error("Failed to open " + path);
+    }
+    return file;
+}
+
+// Only the region, the patches and the trailer are written; the rest of the file stays
+static void write_in_place(const std::string& path, const EditPlan& plan) {
+    FilePtr file = open_file(path, "r+b");
+    FileSink sink(file.get(), path);
+    auto seek = [&](uint64_t offset) {
+        if (pylibheif_fseek(file.get(), static_cast<int64_t>(offset), SEEK_SET) != 0) {
+            throw std::runtime_error("Failed to seek in " + path);
+        }
+    };
+    seek(plan.region_start);
+    sink.write(plan.region.data(), plan.region.size());
+    const std::vector<uint8_t> zeros(64 << 10, 0);
+    for (const Patch& patch : plan.patches) {
+        seek(patch.offset);
+        if (!patch.data.empty()) {
+            sink.write(patch.data.data(), patch.data.size());
+            continue;
+        }
+        for (uint64_t left = patch.length; left > 0;) {
+            const size_t n = static_cast<size_t>(std::min<uint64_t>(left, zeros.size()));
+            sink.write(zeros.data(), n);
+            left -= n;
+        }
+    }
+    if (!plan.trailer.empty()) {
+        seek(plan.input_size);
+        sink.write(plan.trailer.data(), plan.trailer.size());
+    }
+    if (std::fflush(file.get()) != 0) {
+        throw std::runtime_error("Failed to write " + path);
+    }
+}
+
+py::object edit_metadata(const py::object& input, const py::object& output,
+                         const MetadataEdit& edit, bool in_place) {
+    if ((edit.exif && edit.remove_exif) || (edit.xmp && edit.remove_xmp)) {
+        throw std::invalid_argument("A metadata kind cannot be both replaced and removed");
+    }
+    BatchInput source_input = resolve_input(input, "edit_metadata");
+    std::string output_path;
+    if (!output.is_none()) {
+        output_path = py::module_::import("os").attr("fspath")(output).cast<std::string>();
+    }
+    if (in_place && (source_input.path.empty() || !output.is_none())) {
+        throw std::invalid_argument("in_place edits need a path input and no output");
+    }
+
+    std::unique_ptr<ByteSource> source;
+    EditPlan plan;
+    {
+        py::gil_scoped_release release;
+        source = open_source(source_input);
+        plan = plan_edit(*source, edit, in_place);
+    }
+
+    if (in_place) {
+        source.reset();
+        py::gil_scoped_release release;
+        write_in_place(source_input.path, plan);
+        return py::none();
+    }
+
+    if (!output_path.empty()) {
+        std::error_code ec;
+        if (!source_input.path.empty() &&
+            std::filesystem::equivalent(source_input.path, output_path, ec)) {
+            throw std::invalid_argument("output is the input file; use in_place=True");
+        }
+        py::gil_scoped_release release;
+        FilePtr file = open_file(output_path, "wb");
+        FileSink sink(file.get(), output_path);
+        write_edited(*source, plan, sink);
+        if (std::fflush(file.get()) != 0) {
+            throw std::runtime_error("Failed to write " + output_path);
+        }
+        return py::none();
+    }
+
+    // The result goes straight into a preallocated bytes object
+    const uint64_t size = plan.output_size();
+    PyObject* bytes = PyBytes_FromStringAndSize(nullptr, static_cast<py::ssize_t>(size));
+    if (!bytes) {
+        throw py::error_already_set();
+    }
+    py::object result = py::reinterpret_steal<py::object>(bytes);
+    {
+        py::gil_scoped_release release;
+        MemorySink sink(reinterpret_cast<uint8_t*>(PyBytes_AS_STRING(bytes)), size);
+        write_edited(*source, plan, sink);
+    }
+    return result;
+}
+
+}  // namespace pylibheif
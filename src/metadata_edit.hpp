@@ -0,0 +1,30 @@
+#pragma once
+#include <optional>
+#include <string>
+
+#include "common.hpp"
+
+namespace pylibheif {
+
+// What edit_metadata changes. Replacing or removing a kind affects every block of that kind
+// in the file; new blocks describe the primary image.
+struct MetadataEdit {
+    std::optional<std::string> exif;  // TIFF data, optionally preceded by "Exif\0\0"
+    std::optional<std::string> xmp;   // XMP packet
+    bool remove_exif = false;
+    bool remove_xmp = false;
+    size_t padding = 0;  // Size of a 'free' box reserved after 'meta' for later in-place edits
+};
+
+// Rewrites only the 'meta' box of a HEIF file. Shifted 'iloc' offsets are fixed up, the
+// coded image data is copied through untouched (never decoded or buffered), payloads of
+// removed blocks are zeroed in place and new payloads go into a trailing 'mdat'. Files with
+// tracks ('moov'/'moof') are rejected, since their sample offsets are not rewritten.
+//
+// Writes to `output` (a path), returns the result as bytes when output is None, or with
+// in_place edits the input file directly; in place, the new 'meta' box must fit into the old
+// one plus any 'free' boxes right after it.
+py::object edit_metadata(const py::object& input, const py::object& output,
+                         const MetadataEdit& edit, bool in_place);
+
+}  // namespace pylibheif
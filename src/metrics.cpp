@@ -0,0 +1,216 @@
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "image.hpp"
+
+namespace pylibheif {
+
+QualityMetric parse_quality_metric(const std::string& name) {
+    if (name == "ssim") {
+        return QualityMetric::SSIM;
+    }
+    if (name == "psnr") {
+        return QualityMetric::PSNR;
+    }
+    throw std::invalid_argument("metric must be 'ssim' or 'psnr'");
+}
+
+// One color component of a plane: every `step`-th sample starting at `offset`
+struct Component {
+    const uint8_t* data;
+    size_t stride;
+    int width;
+    int height;
+    int step;
+    int offset;
+    int bytes_per_channel;
+    bool swap;  // 16-bit samples in foreign byte order
+};
+
+// Widens one row of a component into contiguous samples for the kernels below
+static void load_row(const Component& c, int y, int32_t* out) {
+    const uint8_t* row = c.data + static_cast<size_t>(y) * c.stride;
+    if (c.bytes_per_channel == 1) {
+        for (int x = 0; x < c.width; ++x) {
+            out[x] = row[x * c.step + c.offset];
+        }
+        return;
+    }
+    for (int x = 0; x < c.width; ++x) {
+        uint16_t value;
+        std::memcpy(&value, row + 2 * (x * c.step + c.offset), 2);
+        out[x] = c.swap ? static_cast<uint16_t>((value >> 8) | (value << 8)) : value;
+    }
+}
+
+PYLIBHEIF_TARGET_CLONES
+static int64_t row_squared_error(const int32_t* a, const int32_t* b, int n) {
+    int64_t sum = 0;
+    for (int i = 0; i < n; ++i) {
+        const int64_t d = a[i] - b[i];
+        sum += d * d;
+    }
+    return sum;
+}
+
+struct BlockSums {
+    int64_t s1 = 0;   // Sum of reference samples
+    int64_t s2 = 0;   // Sum of distorted samples
+    int64_t ss = 0;   // Sum of squares of both
+    int64_t s12 = 0;  // Sum of products
+};
+
+// Adds one row of samples into consecutive 4-pixel-wide blocks
+PYLIBHEIF_TARGET_CLONES
+static void row_block_sums(const int32_t* a, const int32_t* b, int blocks, BlockSums* sums) {
+    for (int i = 0; i < blocks; ++i) {
+        int64_t s1 = 0, s2 = 0, ss = 0, s12 = 0;
+        for (int k = 0; k < 4; ++k) {
+            const int64_t x = a[4 * i + k];
+            const int64_t y = b[4 * i + k];
+            s1 += x;
+            s2 += y;
+            ss += x * x + y * y;
+            s12 += x * y;
+        }
+        sums[i].s1 += s1;
+        sums[i].s2 += s2;
+        sums[i].ss += ss;
+        sums[i].s12 += s12;
+    }
+}
+
+static double ssim_from_sums(const BlockSums& s, double count, double c1, double c2) {
+    const double mu1 = s.s1 / count;
+    const double mu2 = s.s2 / count;
+    const double variances = s.ss / count - mu1 * mu1 - mu2 * mu2;
+    const double covariance = s.s12 / count - mu1 * mu2;
+    return ((2 * mu1 * mu2 + c1) * (2 * covariance + c2)) /
+           ((mu1 * mu1 + mu2 * mu2 + c1) * (variances + c2));
+}
+
+static double component_ssim(const Component& a, const Component& b, double max_value) {
+    const double c1 = (0.01 * max_value) * (0.01 * max_value);
+    const double c2 = (0.03 * max_value) * (0.03 * max_value);
+    std::vector<int32_t> ra(a.width), rb(a.width);
+
+    // 8x8 windows are assembled from 2x2 groups of 4x4 block sums, as in libvpx/ffmpeg
+    const int bw = a.width / 4;
+    const int bh = a.height / 4;
+    if (bw < 2 || bh < 2) {
+        // Too small for one window: a single window over the whole plane
+        BlockSums total;
+        for (int y = 0; y < a.height; ++y) {
+            load_row(a, y, ra.data());
+            load_row(b, y, rb.data());
+            for (int x = 0; x < a.width; ++x) {
+                total.s1 += ra[x];
+                total.s2 += rb[x];
+                total.ss += int64_t(ra[x]) * ra[x] + int64_t(rb[x]) * rb[x];
+                total.s12 += int64_t(ra[x]) * rb[x];
+            }
+        }
+        return ssim_from_sums(total, double(a.width) * a.height, c1, c2);
+    }
+
+    std::vector<BlockSums> prev(bw), cur(bw);
+    auto block_row = [&](int by, std::vector<BlockSums>& sums) {
+        std::fill(sums.begin(), sums.end(), BlockSums());
+        for (int r = 0; r < 4; ++r) {
+            load_row(a, by * 4 + r, ra.data());
+            load_row(b, by * 4 + r, rb.data());
+            row_block_sums(ra.data(), rb.data(), bw, sums.data());
+        }
+    };
+
+    double total = 0;
+    block_row(0, prev);
+    for (int by = 1; by < bh; ++by) {
+        block_row(by, cur);
+        for (int bx = 0; bx + 1 < bw; ++bx) {
+            BlockSums window;
+            for (const BlockSums* s : {&prev[bx], &prev[bx + 1], &cur[bx], &cur[bx + 1]}) {
+                window.s1 += s->s1;
+                window.s2 += s->s2;
+                window.ss += s->ss;
+                window.s12 += s->s12;
+            }
+            total += ssim_from_sums(window, 64, c1, c2);
+        }
+        std::swap(prev, cur);
+    }
+    return total / (double(bw - 1) * (bh - 1));
+}
+
+// Mean squared error normalized by the squared sample range
+static double component_mse(const Component& a, const Component& b, double max_value) {
+    std::vector<int32_t> ra(a.width), rb(a.width);
+    double sum = 0;
+    for (int y = 0; y < a.height; ++y) {
+        load_row(a, y, ra.data());
+        load_row(b, y, rb.data());
+        sum += static_cast<double>(row_squared_error(ra.data(), rb.data(), a.width));
+    }
+    return sum / (double(a.width) * a.height) / (max_value * max_value);
+}
+
+double compare_images(const heif_image* reference, const heif_image* distorted,
+                      QualityMetric metric) {
+    if (heif_image_get_chroma_format(reference) != heif_image_get_chroma_format(distorted) ||
+        heif_image_get_primary_width(reference) != heif_image_get_primary_width(distorted) ||
+        heif_image_get_primary_height(reference) != heif_image_get_primary_height(distorted)) {
+        throw std::invalid_argument("Images must have the same size and chroma format");
+    }
+
+    double weighted = 0;
+    double samples = 0;
+    for (heif_channel channel : kAllChannels) {
+        if (channel == heif_channel_Alpha || !heif_image_has_channel(reference, channel)) {
+            continue;
+        }
+        if (!heif_image_has_channel(distorted, channel)) {
+            throw std::invalid_argument("Images must have the same planes");
+        }
+        const PlaneLayout la = describe_plane(reference, channel);
+        const PlaneLayout lb = describe_plane(distorted, channel);
+        if (la.width != lb.width || la.height != lb.height || la.bits != lb.bits) {
+            throw std::invalid_argument("Images must have the same plane sizes and bit depths");
+        }
+
+        int stride_a, stride_b;
+        const uint8_t* data_a = heif_image_get_plane_readonly(reference, channel, &stride_a);
+        const uint8_t* data_b = heif_image_get_plane_readonly(distorted, channel, &stride_b);
+        const double max_value = double((1 << la.bits) - 1);
+        // Interleaved RGBA keeps its alpha in the last component
+        const int components = la.channels == 4 ? 3 : la.channels;
+        for (int k = 0; k < components; ++k) {
+            const bool swap = la.byte_order != ByteOrder::Native;
+            Component a{data_a, static_cast<size_t>(stride_a), la.width, la.height,
+                        la.channels, k, la.bytes_per_channel, swap};
+            Component b = a;
+            b.data = data_b;
+            b.stride = static_cast<size_t>(stride_b);
+
+            const double count = double(la.width) * la.height;
+            weighted += count * (metric == QualityMetric::SSIM ? component_ssim(a, b, max_value)
+                                                               : component_mse(a, b, max_value));
+            samples += count;
+        }
+    }
+    if (samples == 0) {
+        throw std::invalid_argument("Images have no color planes to compare");
+    }
+
+    if (metric == QualityMetric::SSIM) {
+        return weighted / samples;
+    }
+    const double mse = weighted / samples;
+    return mse > 0 ? std::min(100.0, -10.0 * std::log10(mse)) : 100.0;
+}
+
+}  // namespace pylibheif
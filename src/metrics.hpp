@@ -0,0 +1,20 @@
+#pragma once
+#include <string>
+
+#include "common.hpp"
+
+namespace pylibheif {
+
+enum class QualityMetric { SSIM, PSNR };
+
+// Parses "ssim" or "psnr"; throws std::invalid_argument otherwise
+QualityMetric parse_quality_metric(const std::string& name);
+
+// Compares the color components of two images with the same size, chroma and bit depths;
+// alpha is ignored. SSIM is the mean over 8x8 windows (step 4), PSNR is in dB and capped at
+// 100 for identical images. Components are weighted by their sample count. Does not need the
+// GIL.
+double compare_images(const heif_image* reference, const heif_image* distorted,
+                      QualityMetric metric);
+
+}  // namespace pylibheif
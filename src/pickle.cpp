@@ -0,0 +1,166 @@
+#include "pickle.hpp"
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <pybind11/numpy.h>
+
+#include "pool.hpp"
+
+namespace pylibheif {
+
+// Bumped whenever the state tuple changes, so old pickles fail loudly instead of misloading
+static constexpr int kStateVersion = 1;
+
+static py::object nclx_state(const heif_image* img) {
+    heif_color_profile_nclx* nclx = nullptr;
+    if (heif_image_get_nclx_color_profile(img, &nclx).code != heif_error_Ok || !nclx) {
+        return py::none();
+    }
+    py::tuple state = py::make_tuple(static_cast<int>(nclx->color_primaries),
+                                     static_cast<int>(nclx->transfer_characteristics),
+                                     static_cast<int>(nclx->matrix_coefficients),
+                                     nclx->full_range_flag != 0);
+    heif_nclx_color_profile_free(nclx);
+    return state;
+}
+
+static py::object icc_state(const heif_image* img) {
+    size_t size = heif_image_get_raw_color_profile_size(img);
+    if (size == 0) {
+        return py::none();
+    }
+    std::string icc(size, '\0');
+    check_error(heif_image_get_raw_color_profile(img, icc.data()));
+    const char* type =
+        heif_image_get_color_profile_type(img) == heif_color_profile_type_rICC ? "rICC" : "prof";
+    return py::make_tuple(type, py::bytes(icc));
+}
+
+py::tuple reduce_image(const std::shared_ptr<HeifImage>& image, int protocol) {
+    const heif_image* img = image->get();
+    py::object owner = py::cast(image);
+    py::object pickle_buffer =
+        protocol >= 5 ? py::module_::import("pickle").attr("PickleBuffer") : py::object();
+
+    py::list planes;
+    for (heif_channel channel : kAllChannels) {
+        if (!heif_image_has_channel(img, channel)) {
+            continue;
+        }
+        int stride;
+        const uint8_t* data = heif_image_get_plane_readonly(img, channel, &stride);
+        const int width = heif_image_get_width(img, channel);
+        const int height = heif_image_get_height(img, channel);
+        const py::ssize_t size = static_cast<py::ssize_t>(stride) * height;
+
+        py::object payload;
+        if (protocol >= 5) {
+            // Flat read-only view whose base keeps the image (and so the plane) alive
+            py::array view(py::dtype::of<uint8_t>(), {size}, {py::ssize_t(1)}, data, owner);
+            view.attr("setflags")(py::arg("write") = false);
+            payload = pickle_buffer(view);
+        } else {
+            payload = py::bytes(reinterpret_cast<const char*>(data), size);
+        }
+        planes.append(py::make_tuple(static_cast<int>(channel), width, height,
+                                     heif_image_get_bits_per_pixel_range(img, channel), stride,
+                                     payload));
+    }
+
+    py::tuple state = py::make_tuple(
+        kStateVersion, heif_image_get_primary_width(img), heif_image_get_primary_height(img),
+        static_cast<int>(heif_image_get_colorspace(img)),
+        static_cast<int>(heif_image_get_chroma_format(img)), planes,
+        heif_image_is_premultiplied_alpha(img) != 0, nclx_state(img), icc_state(img));
+    py::object rebuild = py::module_::import("pylibheif._pylibheif").attr("_rebuild_image");
+    return py::make_tuple(rebuild, py::make_tuple(state));
+}
+
+std::shared_ptr<HeifImage> rebuild_image(const py::tuple& state) {
+    if (state.size() != 9 || state[0].cast<int>() != kStateVersion) {
+        throw std::invalid_argument("Unsupported HeifImage pickle state");
+    }
+
+    // Profiles come first: they select which pooled images may be recycled
+    std::unique_ptr<heif_color_profile_nclx, decltype(&heif_nclx_color_profile_free)> nclx(
+        nullptr, &heif_nclx_color_profile_free);
+    if (!state[7].is_none()) {
+        py::tuple values = state[7].cast<py::tuple>();
+        nclx.reset(heif_nclx_color_profile_alloc());
+        nclx->color_primaries = static_cast<heif_color_primaries>(values[0].cast<int>());
+        nclx->transfer_characteristics =
+            static_cast<heif_transfer_characteristics>(values[1].cast<int>());
+        nclx->matrix_coefficients = static_cast<heif_matrix_coefficients>(values[2].cast<int>());
+        nclx->full_range_flag = values[3].cast<bool>() ? 1 : 0;
+    }
+    std::string icc_type = "prof";
+    std::string icc;
+    if (!state[8].is_none()) {
+        py::tuple values = state[8].cast<py::tuple>();
+        icc_type = values[0].cast<std::string>();
+        icc = values[1].cast<std::string>();
+        if (icc_type.size() != 4) {
+            throw std::invalid_argument("Unsupported HeifImage pickle state");
+        }
+    }
+
+    std::vector<py::tuple> planes;
+    std::vector<PlaneSpec> specs;
+    for (auto item : state[5].cast<py::list>()) {
+        py::tuple plane = item.cast<py::tuple>();
+        specs.push_back({static_cast<heif_channel>(plane[0].cast<int>()), plane[1].cast<int>(),
+                         plane[2].cast<int>(), plane[3].cast<int>()});
+        planes.push_back(std::move(plane));
+    }
+    heif_image* img = acquire_image(
+        state[1].cast<int>(), state[2].cast<int>(),
+        static_cast<heif_colorspace>(state[3].cast<int>()),
+        static_cast<heif_chroma>(state[4].cast<int>()), specs,
+        color_profile_key(nclx.get(), icc_type.c_str(),
+                          reinterpret_cast<const uint8_t*>(icc.data()), icc.size()));
+    auto image = std::make_shared<HeifImage>(img, true);
+
+    for (size_t i = 0; i < specs.size(); ++i) {
+        const PlaneSpec& spec = specs[i];
+        if (spec.height == 0) {
+            continue;
+        }
+        const py::ssize_t src_stride = planes[i][4].cast<py::ssize_t>();
+        const size_t row_bytes =
+            static_cast<size_t>(spec.width) * image->plane_layout(spec.channel).bytes_per_pixel();
+        py::buffer_info info = planes[i][5].cast<py::buffer>().request();
+        const size_t size = static_cast<size_t>(info.size * info.itemsize);
+        if (src_stride < static_cast<py::ssize_t>(row_bytes) ||
+            size < static_cast<size_t>(src_stride) * (spec.height - 1) + row_bytes) {
+            throw std::invalid_argument("HeifImage pickle plane data is too short");
+        }
+
+        int dst_stride;
+        uint8_t* dst = heif_image_get_plane(img, spec.channel, &dst_stride);
+        const auto* src = static_cast<const uint8_t*>(info.ptr);
+        py::gil_scoped_release release;
+        if (src_stride == dst_stride) {
+            memcpy(dst, src, static_cast<size_t>(dst_stride) * (spec.height - 1) + row_bytes);
+        } else {
+            for (int y = 0; y < spec.height; ++y) {
+                memcpy(dst + static_cast<size_t>(y) * dst_stride,
+                       src + static_cast<size_t>(y) * src_stride, row_bytes);
+            }
+        }
+    }
+
+    heif_image_set_premultiplied_alpha(img, state[6].cast<bool>() ? 1 : 0);
+    if (nclx) {
+        check_error(heif_image_set_nclx_color_profile(img, nclx.get()));
+    }
+    if (!icc.empty()) {
+        check_error(
+            heif_image_set_raw_color_profile(img, icc_type.c_str(), icc.data(), icc.size()));
+    }
+    return image;
+}
+
+}  // namespace pylibheif
@@ -0,0 +1,19 @@
+#pragma once
+#include <memory>
+
+#include "common.hpp"
+#include "image.hpp"
+
+namespace pylibheif {
+
+// HeifImage.__reduce_ex__: (_rebuild_image, (state,)) with the planes as raw rows. From
+// protocol 5 on each plane is a PickleBuffer over the image's own memory, so
+// pickle.dumps(..., buffer_callback=...) hands the pixels out of band without a copy; older
+// protocols embed a bytes copy.
+py::tuple reduce_image(const std::shared_ptr<HeifImage>& image, int protocol);
+
+// Inverse of reduce_image. libheif owns its plane memory, so the rows are copied once into
+// freshly allocated planes, or those of a pooled image with the same layout and profiles.
+std::shared_ptr<HeifImage> rebuild_image(const py::tuple& state);
+
+}  // namespace pylibheif
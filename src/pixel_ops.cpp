@@ -0,0 +1,289 @@
+#include "pixel_ops.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "image.hpp"
+
+namespace pylibheif {
+
+// Interleaved RGBA plane of img in host byte order, or invalid_argument
+static PlaneLayout rgba_layout(const heif_image* img) {
+    if (!heif_image_has_channel(img, heif_channel_interleaved)) {
+        throw std::invalid_argument("Alpha premultiplication needs an interleaved RGBA image");
+    }
+    PlaneLayout layout = describe_plane(img, heif_channel_interleaved);
+    if (layout.channels != 4) {
+        throw std::invalid_argument("Alpha premultiplication needs an interleaved RGBA image");
+    }
+    if (layout.byte_order != ByteOrder::Native) {
+        throw std::invalid_argument(
+            "16-bit images must be in host byte order (decode with decode_hdr(alpha=True))");
+    }
+    return layout;
+}
+
+// x * a / 255 rounded to nearest, exact for 8-bit inputs and free of divisions
+PYLIBHEIF_TARGET_CLONES
+static void premultiply_row_u8(uint8_t* p, size_t pixels) {
+    for (size_t i = 0; i < pixels; ++i) {
+        const uint32_t a = p[4 * i + 3];
+        for (int c = 0; c < 3; ++c) {
+            const uint32_t x = p[4 * i + c] * a + 128;
+            p[4 * i + c] = static_cast<uint8_t>((x + (x >> 8)) >> 8);
+        }
+    }
+}
+
+PYLIBHEIF_TARGET_CLONES
+static void premultiply_row_u16(uint16_t* p, size_t pixels, double inv_max) {
+    for (size_t i = 0; i < pixels; ++i) {
+        const double a = p[4 * i + 3] * inv_max;
+        for (int c = 0; c < 3; ++c) {
+            p[4 * i + c] = static_cast<uint16_t>(p[4 * i + c] * a + 0.5);
+        }
+    }
+}
+
+// One fixed-point reciprocal per alpha value replaces the division
+static void unpremultiply_row_u8(uint8_t* p, size_t pixels, const uint32_t* reciprocal) {
+    for (size_t i = 0; i < pixels; ++i) {
+        const uint32_t r = reciprocal[p[4 * i + 3]];
+        for (int c = 0; c < 3; ++c) {
+            const uint32_t x = (p[4 * i + c] * r + 32768) >> 16;
+            p[4 * i + c] = static_cast<uint8_t>(std::min<uint32_t>(x, 255));
+        }
+    }
+}
+
+PYLIBHEIF_TARGET_CLONES
+static void unpremultiply_row_u16(uint16_t* p, size_t pixels, double max_value) {
+    for (size_t i = 0; i < pixels; ++i) {
+        const uint16_t a = p[4 * i + 3];
+        const double scale = a ? max_value / a : 0.0;
+        for (int c = 0; c < 3; ++c) {
+            p[4 * i + c] =
+                static_cast<uint16_t>(std::min(p[4 * i + c] * scale + 0.5, max_value));
+        }
+    }
+}
+
+static void convert_alpha(heif_image* img, bool premultiply) {
+    const PlaneLayout layout = rgba_layout(img);
+    if ((heif_image_is_premultiplied_alpha(img) != 0) == premultiply) {
+        return;
+    }
+    int stride;
+    uint8_t* data = heif_image_get_plane(img, heif_channel_interleaved, &stride);
+    const size_t width = static_cast<size_t>(layout.width);
+    const double max_value = static_cast<double>((1 << layout.bits) - 1);
+
+    uint32_t reciprocal[256];
+    if (!premultiply && layout.bytes_per_channel == 1) {
+        reciprocal[0] = 0;
+        for (uint32_t a = 1; a < 256; ++a) {
+            reciprocal[a] = ((255u << 16) + a / 2) / a;
+        }
+    }
+    for (int y = 0; y < layout.height; ++y) {
+        uint8_t* row = data + static_cast<size_t>(y) * stride;
+        if (layout.bytes_per_channel == 1) {
+            premultiply ? premultiply_row_u8(row, width)
+                        : unpremultiply_row_u8(row, width, reciprocal);
+        } else {
+            uint16_t* row16 = reinterpret_cast<uint16_t*>(row);
+            premultiply ? premultiply_row_u16(row16, width, 1.0 / max_value)
+                        : unpremultiply_row_u16(row16, width, max_value);
+        }
+    }
+    heif_image_set_premultiplied_alpha(img, premultiply ? 1 : 0);
+}
+
+void premultiply_alpha(heif_image* img) { convert_alpha(img, true); }
+
+void unpremultiply_alpha(heif_image* img) { convert_alpha(img, false); }
+
+// sRGB EOTF for every code value of a `bits` deep channel
+static std::vector<float> srgb_to_linear_table(int bits) {
+    const int count = 1 << bits;
+    std::vector<float> table(count);
+    for (int i = 0; i < count; ++i) {
+        const double v = static_cast<double>(i) / (count - 1);
+        table[i] = static_cast<float>(v <= 0.04045 ? v / 12.92
+                                                   : std::pow((v + 0.055) / 1.055, 2.4));
+    }
+    return table;
+}
+
+// Source sample pair and weight of each output position for bilinear upsampling
+struct BilinearAxis {
+    std::vector<int> first;
+    std::vector<int> second;
+    std::vector<float> weight;  // Of `second`
+};
+
+static BilinearAxis bilinear_axis(int src_len, int dst_len) {
+    BilinearAxis axis;
+    axis.first.resize(dst_len);
+    axis.second.resize(dst_len);
+    axis.weight.resize(dst_len);
+    const double scale = static_cast<double>(src_len) / dst_len;
+    for (int i = 0; i < dst_len; ++i) {
+        // Pixel centers are aligned, as in the gain map specs
+        const double pos = std::clamp((i + 0.5) * scale - 0.5, 0.0, src_len - 1.0);
+        const int first = static_cast<int>(pos);
+        axis.first[i] = first;
+        axis.second[i] = std::min(first + 1, src_len - 1);
+        axis.weight[i] = static_cast<float>(pos - first);
+    }
+    return axis;
+}
+
+// Gain map samples mapped to linear boost factors
+struct GainPlane {
+    const uint8_t* data;
+    int stride;
+    int width;
+    int height;
+    int channels;          // 1 (monochrome) or 3
+    int pixel;             // Samples per pixel in the plane
+    int bytes_per_sample;  // 1 or 2
+    std::vector<float> factor;
+};
+
+static GainPlane gain_plane(const heif_image* gain_map, const GainMapParams& params) {
+    GainPlane plane;
+    heif_channel channel = heif_channel_interleaved;
+    if (heif_image_get_chroma_format(gain_map) == heif_chroma_monochrome ||
+        !heif_image_has_channel(gain_map, heif_channel_interleaved)) {
+        channel = heif_channel_Y;
+        if (!heif_image_has_channel(gain_map, channel)) {
+            throw std::invalid_argument("gain_map must be a monochrome or interleaved RGB image");
+        }
+    }
+    const PlaneLayout layout = describe_plane(gain_map, channel);
+    if (layout.byte_order != ByteOrder::Native) {
+        throw std::invalid_argument("16-bit gain maps must be in host byte order");
+    }
+    plane.data = heif_image_get_plane_readonly(gain_map, channel, &plane.stride);
+    plane.width = layout.width;
+    plane.height = layout.height;
+    plane.pixel = layout.channels;
+    plane.channels = layout.channels >= 3 ? 3 : 1;
+    plane.bytes_per_sample = layout.bytes_per_channel;
+
+    const int count = 1 << layout.bits;
+    plane.factor.resize(count);
+    for (int i = 0; i < count; ++i) {
+        const double g = static_cast<double>(i) / (count - 1);
+        const double curve = params.gamma == 1.f ? g : std::pow(g, 1.0 / params.gamma);
+        const double boost =
+            (params.gain_min + (params.gain_max - params.gain_min) * curve) * params.weight;
+        plane.factor[i] = static_cast<float>(std::exp2(boost));
+    }
+    return plane;
+}
+
+// hdr = (sdr + offset_sdr) * factor - offset_hdr over one row of packed RGB floats
+PYLIBHEIF_TARGET_CLONES
+static void apply_row(float* out, const float* factor, size_t n, float offset_sdr,
+                      float offset_hdr) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = (out[i] + offset_sdr) * factor[i] - offset_hdr;
+    }
+}
+
+PYLIBHEIF_TARGET_CLONES
+static void lerp_row(const float* a, const float* b, float weight, float* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = a[i] + (b[i] - a[i]) * weight;
+    }
+}
+
+void apply_gain_map(const heif_image* base, const heif_image* gain_map,
+                    const GainMapParams& params, float* out, size_t out_stride) {
+    if (!heif_image_has_channel(base, heif_channel_interleaved)) {
+        throw std::invalid_argument("The base image must be interleaved RGB(A)");
+    }
+    const PlaneLayout layout = describe_plane(base, heif_channel_interleaved);
+    if (layout.channels < 3 || layout.byte_order != ByteOrder::Native) {
+        throw std::invalid_argument(
+            "The base image must be interleaved RGB(A) in host byte order");
+    }
+    if (params.gamma <= 0.f) {
+        throw std::invalid_argument("gamma must be > 0");
+    }
+    int base_stride;
+    const uint8_t* base_data =
+        heif_image_get_plane_readonly(base, heif_channel_interleaved, &base_stride);
+    const std::vector<float> to_linear = srgb_to_linear_table(layout.bits);
+    const GainPlane gain = gain_plane(gain_map, params);
+
+    const int width = layout.width;
+    const int height = layout.height;
+    const BilinearAxis ax = bilinear_axis(gain.width, width);
+    const BilinearAxis ay = bilinear_axis(gain.height, height);
+
+    // Gain factors of the two source rows upsampled horizontally, cached across output rows
+    const size_t row_len = static_cast<size_t>(width) * 3;
+    std::vector<float> rows[2] = {std::vector<float>(row_len), std::vector<float>(row_len)};
+    int cached[2] = {-1, -1};
+    std::vector<float> factor(row_len);
+
+    auto sample = [&](const uint8_t* row, int x, int c) {
+        const int index = x * gain.pixel + (gain.channels == 3 ? c : 0);
+        return gain.bytes_per_sample == 1
+                   ? gain.factor[row[index]]
+                   : gain.factor[std::min<size_t>(reinterpret_cast<const uint16_t*>(row)[index],
+                                                  gain.factor.size() - 1)];
+    };
+    auto upsample_row = [&](int src_y, std::vector<float>& dst) {
+        const uint8_t* row = gain.data + static_cast<size_t>(src_y) * gain.stride;
+        for (int x = 0; x < width; ++x) {
+            const float w = ax.weight[x];
+            for (int c = 0; c < 3; ++c) {
+                const float a = sample(row, ax.first[x], c);
+                const float b = sample(row, ax.second[x], c);
+                dst[3 * x + c] = a + (b - a) * w;
+            }
+        }
+    };
+    auto gain_row = [&](int src_y) -> const std::vector<float>& {
+        for (int k = 0; k < 2; ++k) {
+            if (cached[k] == src_y) {
+                return rows[k];
+            }
+        }
+        // Rows are visited in increasing order, so the older slot is the one to reuse
+        const int slot = cached[0] < cached[1] ? 0 : 1;
+        upsample_row(src_y, rows[slot]);
+        cached[slot] = src_y;
+        return rows[slot];
+    };
+
+    const size_t max_code = to_linear.size() - 1;
+    for (int y = 0; y < height; ++y) {
+        const std::vector<float>& top = gain_row(ay.first[y]);
+        const std::vector<float>& bottom = gain_row(ay.second[y]);
+        lerp_row(top.data(), bottom.data(), ay.weight[y], factor.data(), row_len);
+
+        float* dst = out + static_cast<size_t>(y) * out_stride;
+        const uint8_t* src = base_data + static_cast<size_t>(y) * base_stride;
+        for (int x = 0; x < width; ++x) {
+            for (int c = 0; c < 3; ++c) {
+                const size_t index = static_cast<size_t>(x) * layout.channels + c;
+                const size_t code =
+                    layout.bytes_per_channel == 1
+                        ? src[index]
+                        : std::min<size_t>(reinterpret_cast<const uint16_t*>(src)[index],
+                                           max_code);
+                dst[3 * x + c] = to_linear[code];
+            }
+        }
+        apply_row(dst, factor.data(), row_len, params.offset_sdr, params.offset_hdr);
+    }
+}
+
+}  // namespace pylibheif
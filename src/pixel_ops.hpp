@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+
+#include "common.hpp"
+
+namespace pylibheif {
+
+// In-place conversion of the color samples of an interleaved RGBA / RRGGBBAA image (host
+// byte order) to and from alpha-premultiplied form, with rounding. Updates the image's
+// premultiplied flag and does nothing if it is already in the requested form. Pure C++ so
+// it can run without the GIL.
+void premultiply_alpha(heif_image* img);
+void unpremultiply_alpha(heif_image* img);
+
+// Gain map transform of ISO 21496-1 (and Adobe's gain map spec), applied per channel:
+//   log2 boost = (gain_min + (gain_max - gain_min) * g^(1/gamma)) * weight
+//   hdr = (sdr + offset_sdr) * 2^boost - offset_hdr
+// with sdr the sRGB-decoded base and g the gain map sample in [0, 1]. Apple's gain maps
+// are approximated by gain_max = log2(headroom) with zero offsets.
+struct GainMapParams {
+    float gain_min = 0.f;
+    float gain_max = 1.f;
+    float gamma = 1.f;
+    float offset_sdr = 1.f / 64;
+    float offset_hdr = 1.f / 64;
+    float weight = 1.f;
+};
+
+// Writes linear-light float RGB (SDR white = 1.0) of an interleaved RGB(A) base image into
+// out (height rows of `out_stride` floats). The monochrome or RGB gain map is bilinearly
+// upsampled to the base size. Pure C++ so it can run without the GIL.
+void apply_gain_map(const heif_image* base, const heif_image* gain_map,
+                    const GainMapParams& params, float* out, size_t out_stride);
+
+}  // namespace pylibheif
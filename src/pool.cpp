@@ -0,0 +1,237 @@
+#include "pool.hpp"
+
+#include <map>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+#include "image.hpp"
+#include "stats.hpp"
+
+namespace pylibheif {
+
+struct PoolKey {
+    int width;
+    int height;
+    heif_colorspace colorspace;
+    heif_chroma chroma;
+    std::vector<PlaneSpec> planes;
+    std::string profiles;  // color_profile_key of the image
+
+    bool operator<(const PoolKey& other) const {
+        auto head = [](const PoolKey& k) {
+            return std::make_tuple(k.width, k.height, k.colorspace, k.chroma, k.planes.size(),
+                                   std::cref(k.profiles));
+        };
+        if (head(*this) != head(other)) {
+            return head(*this) < head(other);
+        }
+        for (size_t i = 0; i < planes.size(); ++i) {
+            auto a = std::make_tuple(planes[i].channel, planes[i].width, planes[i].height,
+                                     planes[i].bits);
+            auto b = std::make_tuple(other.planes[i].channel, other.planes[i].width,
+                                     other.planes[i].height, other.planes[i].bits);
+            if (a != b) {
+                return a < b;
+            }
+        }
+        return false;
+    }
+};
+
+struct PooledImage {
+    heif_image* image;
+    size_t bytes;
+};
+
+struct ImagePool {
+    std::mutex mutex;
+    std::map<PoolKey, std::vector<PooledImage>> free_images;
+    ImagePoolStats stats;
+
+    void clear_locked() {
+        for (auto& entry : free_images) {
+            for (auto& pooled : entry.second) {
+                heif_image_release(pooled.image);
+            }
+        }
+        free_images.clear();
+        stats.pooled_bytes = 0;
+        stats.pooled_images = 0;
+    }
+
+    ~ImagePool() { clear_locked(); }
+};
+
+static ImagePool& pool() {
+    static ImagePool instance;
+    return instance;
+}
+
+std::string color_profile_key(const heif_color_profile_nclx* nclx, const char* icc_type,
+                              const uint8_t* icc, size_t icc_size) {
+    std::string key;
+    if (nclx) {
+        const int fields[4] = {nclx->color_primaries, nclx->transfer_characteristics,
+                               nclx->matrix_coefficients, nclx->full_range_flag};
+        key.push_back('n');
+        key.append(reinterpret_cast<const char*>(fields), sizeof(fields));
+    }
+    if (icc_size > 0) {
+        key.push_back('i');
+        key.append(icc_type, 4);
+        key.append(reinterpret_cast<const char*>(icc), icc_size);
+    }
+    return key;
+}
+
+std::string color_profile_key(const heif_image* image) {
+    heif_color_profile_nclx* nclx = nullptr;
+    if (heif_image_get_nclx_color_profile(image, &nclx).code != heif_error_Ok) {
+        nclx = nullptr;
+    }
+    std::vector<uint8_t> icc(heif_image_get_raw_color_profile_size(image));
+    if (!icc.empty() && heif_image_get_raw_color_profile(image, icc.data()).code != heif_error_Ok) {
+        icc.clear();
+    }
+    const char* type =
+        heif_image_get_color_profile_type(image) == heif_color_profile_type_rICC ? "rICC" : "prof";
+    std::string key = color_profile_key(nclx, type, icc.data(), icc.size());
+    if (nclx) {
+        heif_nclx_color_profile_free(nclx);
+    }
+    return key;
+}
+
+static PoolKey key_of(const heif_image* image) {
+    PoolKey key{heif_image_get_primary_width(image), heif_image_get_primary_height(image),
+                heif_image_get_colorspace(image), heif_image_get_chroma_format(image), {},
+                color_profile_key(image)};
+    for (heif_channel channel : kAllChannels) {
+        if (heif_image_has_channel(image, channel)) {
+            key.planes.push_back({channel, heif_image_get_width(image, channel),
+                                  heif_image_get_height(image, channel),
+                                  heif_image_get_bits_per_pixel_range(image, channel)});
+        }
+    }
+    return key;
+}
+
+static size_t bytes_of(const heif_image* image, const PoolKey& key) {
+    size_t bytes = 0;
+    for (const PlaneSpec& plane : key.planes) {
+        int stride = 0;
+        heif_image_get_plane_readonly(image, plane.channel, &stride);
+        bytes += static_cast<size_t>(stride) * plane.height;
+    }
+    return bytes;
+}
+
+void enable_image_pool(size_t max_bytes) {
+    ImagePool& p = pool();
+    std::lock_guard<std::mutex> lock(p.mutex);
+    p.stats.enabled = true;
+    p.stats.max_bytes = max_bytes;
+}
+
+void disable_image_pool() {
+    ImagePool& p = pool();
+    std::lock_guard<std::mutex> lock(p.mutex);
+    p.stats.enabled = false;
+    p.clear_locked();
+}
+
+void clear_image_pool() {
+    ImagePool& p = pool();
+    std::lock_guard<std::mutex> lock(p.mutex);
+    p.clear_locked();
+}
+
+ImagePoolStats get_image_pool_stats() {
+    ImagePool& p = pool();
+    std::lock_guard<std::mutex> lock(p.mutex);
+    return p.stats;
+}
+
+bool image_pool_enabled() {
+    ImagePool& p = pool();
+    std::lock_guard<std::mutex> lock(p.mutex);
+    return p.stats.enabled;
+}
+
+heif_image* take_pooled_image(int width, int height, heif_colorspace colorspace,
+                              heif_chroma chroma, const std::vector<PlaneSpec>& planes,
+                              const std::string& profiles) {
+    ImagePool& p = pool();
+    std::lock_guard<std::mutex> lock(p.mutex);
+    if (!p.stats.enabled) {
+        return nullptr;
+    }
+    auto it = p.free_images.find(PoolKey{width, height, colorspace, chroma, planes, profiles});
+    if (it == p.free_images.end() || it->second.empty()) {
+        p.stats.misses++;
+        return nullptr;
+    }
+    PooledImage pooled = it->second.back();
+    it->second.pop_back();
+    p.stats.hits++;
+    p.stats.pooled_bytes -= pooled.bytes;
+    p.stats.pooled_images--;
+    // Image state outside the key must not carry over; the caller's pixels start straight
+    heif_image_set_premultiplied_alpha(pooled.image, 0);
+    return pooled.image;
+}
+
+heif_image* acquire_image(int width, int height, heif_colorspace colorspace, heif_chroma chroma,
+                          const std::vector<PlaneSpec>& planes, const std::string& profiles) {
+    ScopedTimer timer(Stage::Allocate);
+    if (heif_image* recycled =
+            take_pooled_image(width, height, colorspace, chroma, planes, profiles)) {
+        if (timer.enabled()) {
+            timer.add_bytes(image_bytes(recycled));
+        }
+        return recycled;
+    }
+    heif_image* image;
+    check_error(heif_image_create(width, height, colorspace, chroma, &image));
+    for (const PlaneSpec& plane : planes) {
+        heif_error err =
+            heif_image_add_plane(image, plane.channel, plane.width, plane.height, plane.bits);
+        if (err.code != heif_error_Ok) {
+            heif_image_release(image);
+            check_error(err);
+        }
+    }
+    if (timer.enabled()) {
+        timer.add_bytes(image_bytes(image));
+    }
+    return image;
+}
+
+bool return_pooled_image(heif_image* image) {
+    ImagePool& p = pool();
+    {
+        std::lock_guard<std::mutex> lock(p.mutex);
+        if (!p.stats.enabled) {
+            return false;
+        }
+    }
+    // Inspect the image outside the lock; it is still exclusively ours
+    PoolKey key = key_of(image);
+    const size_t bytes = bytes_of(image, key);
+    const bool suitable = !key.planes.empty();
+
+    std::lock_guard<std::mutex> lock(p.mutex);
+    if (!p.stats.enabled || !suitable || p.stats.pooled_bytes + bytes > p.stats.max_bytes) {
+        p.stats.rejected++;
+        return false;
+    }
+    p.free_images[std::move(key)].push_back({image, bytes});
+    p.stats.pooled_bytes += bytes;
+    p.stats.pooled_images++;
+    p.stats.returned++;
+    return true;
+}
+
+}  // namespace pylibheif
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "common.hpp"
+
+namespace pylibheif {
+
+// One plane of a pooled image
+struct PlaneSpec {
+    heif_channel channel;
+    int width;
+    int height;
+    int bits;
+};
+
+struct ImagePoolStats {
+    bool enabled = false;
+    size_t max_bytes = 0;
+    size_t pooled_bytes = 0;
+    size_t pooled_images = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t returned = 0;
+    uint64_t rejected = 0;  // Not kept because the pool was full, disabled or the image unsuitable
+};
+
+// Opt-in pool of whole heif_image objects, keyed by size, colorspace, chroma, the exact
+// plane layout and the attached color profiles. libheif allocates plane memory itself and has
+// no allocator hook, so the pool recycles complete images instead; only images allocated by
+// pylibheif (not by libheif's decoders) take part. Thread-safe.
+void enable_image_pool(size_t max_bytes);
+void disable_image_pool();  // Also frees every pooled image
+void clear_image_pool();
+ImagePoolStats get_image_pool_stats();
+bool image_pool_enabled();
+
+// Identifies a set of NCLX / ICC profiles ("" for none). libheif cannot detach profiles from
+// an image, so recycled images keep theirs and are only handed out for the same profiles.
+std::string color_profile_key(const heif_color_profile_nclx* nclx, const char* icc_type,
+                              const uint8_t* icc, size_t icc_size);
+std::string color_profile_key(const heif_image* image);
+
+// Returns a recycled image with exactly these planes and profiles (see color_profile_key), or
+// nullptr (pool disabled or empty). The pixel contents are undefined, as with a fresh
+// heif_image_add_plane; fresh images get no profiles, so callers still attach them.
+heif_image* take_pooled_image(int width, int height, heif_colorspace colorspace,
+                              heif_chroma chroma, const std::vector<PlaneSpec>& planes,
+                              const std::string& profiles = {});
+// take_pooled_image, falling back to a newly created image with the planes added
+heif_image* acquire_image(int width, int height, heif_colorspace colorspace, heif_chroma chroma,
+                          const std::vector<PlaneSpec>& planes, const std::string& profiles = {});
+// Hands an image back to the pool. Returns false if the caller still owns it and must
+// release it (pool disabled or full, or the image has no planes).
+bool return_pooled_image(heif_image* image);
+
+}  // namespace pylibheif
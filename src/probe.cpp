@@ -0,0 +1,127 @@
+#include "probe.hpp"
+
+#include <exception>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "batch.hpp"
+#include "reader.hpp"
+#include "thread_pool.hpp"
+
+namespace pylibheif {
+
+// Orientation (tag 0x0112) from IFD0 of a TIFF-structured Exif payload
+static int parse_exif_orientation(const uint8_t* data, size_t size) {
+    if (size < 8) {
+        return 1;
+    }
+    const bool little = data[0] == 'I' && data[1] == 'I';
+    if (!little && !(data[0] == 'M' && data[1] == 'M')) {
+        return 1;
+    }
+    auto u16 = [&](size_t at) -> uint32_t {
+        return little ? data[at] | (data[at + 1] << 8) : (data[at] << 8) | data[at + 1];
+    };
+    auto u32 = [&](size_t at) -> uint32_t {
+        return little ? u16(at) | (u16(at + 2) << 16) : (u16(at) << 16) | u16(at + 2);
+    };
+
+    const size_t ifd = u32(4);
+    if (ifd + 2 > size) {
+        return 1;
+    }
+    const uint32_t entries = u16(ifd);
+    for (uint32_t i = 0; i < entries; ++i) {
+        const size_t entry = ifd + 2 + i * 12;
+        if (entry + 12 > size) {
+            break;
+        }
+        if (u16(entry) == 0x0112) {
+            const uint32_t value = u16(entry + 8);  // SHORT stored inline
+            return value >= 1 && value <= 8 ? static_cast<int>(value) : 1;
+        }
+    }
+    return 1;
+}
+
+static int read_exif_orientation(const heif_image_handle* handle) {
+    heif_item_id id;
+    if (heif_image_handle_get_list_of_metadata_block_IDs(handle, "Exif", &id, 1) < 1) {
+        return 1;
+    }
+    std::vector<uint8_t> exif(heif_image_handle_get_metadata_size(handle, id));
+    if (exif.size() < 4 || heif_image_handle_get_metadata(handle, id, exif.data()).code !=
+                               heif_error_Ok) {
+        return 1;
+    }
+    // The stored block starts with a 4-byte offset to the TIFF header
+    const size_t offset = 4 + ((size_t(exif[0]) << 24) | (size_t(exif[1]) << 16) |
+                               (size_t(exif[2]) << 8) | size_t(exif[3]));
+    if (offset >= exif.size()) {
+        return 1;
+    }
+    return parse_exif_orientation(exif.data() + offset, exif.size() - offset);
+}
+
+ProbeInfo probe_source(ByteSource& source) {
+    ContextPtr ctx(heif_context_alloc());
+    check_error(heif_context_read_from_reader(ctx.get(), byte_source_reader(), &source, nullptr));
+
+    heif_image_handle* raw_handle;
+    check_error(heif_context_get_primary_image_handle(ctx.get(), &raw_handle));
+    HandlePtr handle(raw_handle);
+
+    ProbeInfo info;
+    info.width = heif_image_handle_get_width(raw_handle);
+    info.height = heif_image_handle_get_height(raw_handle);
+    info.has_alpha = heif_image_handle_has_alpha_channel(raw_handle) != 0;
+    info.luma_bits = heif_image_handle_get_luma_bits_per_pixel(raw_handle);
+    info.chroma_bits = heif_image_handle_get_chroma_bits_per_pixel(raw_handle);
+    info.num_images = heif_context_get_number_of_top_level_images(ctx.get());
+    info.exif_orientation = read_exif_orientation(raw_handle);
+    info.bytes_read = source.bytes_read;
+    return info;
+}
+
+ProbeInfo probe(const py::object& input) {
+    BatchInput source = resolve_input(input, "probe");
+    py::gil_scoped_release release;
+    return probe_source(*open_source(source));
+}
+
+py::list probe_batch(const py::sequence& inputs, int threads, bool raise_errors) {
+    std::vector<BatchInput> items;
+    items.reserve(inputs.size());
+    for (auto item : inputs) {
+        items.push_back(resolve_input(item, "probe_batch"));
+    }
+
+    std::vector<std::optional<ProbeInfo>> results(items.size());
+    std::vector<std::exception_ptr> errors(items.size());
+    {
+        py::gil_scoped_release release;
+        parallel_for(items.size(), threads, [&](size_t i) {
+            try {
+                results[i] = probe_source(*open_source(items[i]));
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+
+    if (raise_errors) {
+        for (auto& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+    py::list result;
+    for (auto& info : results) {
+        result.append(info ? py::cast(*info) : py::none());
+    }
+    return result;
+}
+
+}  // namespace pylibheif
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+
+#include "common.hpp"
+
+namespace pylibheif {
+
+class ByteSource;
+
+// Header-level facts about a file's primary image, gathered without decoding
+struct ProbeInfo {
+    int width = 0;
+    int height = 0;
+    bool has_alpha = false;
+    int luma_bits = 0;
+    int chroma_bits = 0;
+    int num_images = 0;
+    int exif_orientation = 1;  // EXIF tag 0x0112; 1 when absent
+    uint64_t bytes_read = 0;   // Bytes libheif actually requested from the source
+};
+
+// Parses the file structure through a heif_reader and reads no image data. Does not need
+// the GIL.
+ProbeInfo probe_source(ByteSource& source);
+
+ProbeInfo probe(const py::object& input);
+// Probes every input on `threads` native workers without the GIL. With raise_errors=false,
+// unreadable inputs yield None instead of raising.
+py::list probe_batch(const py::sequence& inputs, int threads, bool raise_errors);
+
+}  // namespace pylibheif
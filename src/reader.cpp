@@ -0,0 +1,176 @@
+#include "reader.hpp"
+
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace pylibheif {
+
+static int64_t source_get_position(void* userdata) {
+    return static_cast<ByteSource*>(userdata)->position;
+}
+
+static int source_read(void* data, size_t size, void* userdata) {
+    auto* source = static_cast<ByteSource*>(userdata);
+    if (source->position < 0 || static_cast<int64_t>(size) > source->size() - source->position) {
+        return 1;
+    }
+    if (!source->read_at(data, size, source->position)) {
+        return 1;
+    }
+    source->position += static_cast<int64_t>(size);
+    source->bytes_read += size;
+    return 0;
+}
+
+static int source_seek(int64_t position, void* userdata) {
+    auto* source = static_cast<ByteSource*>(userdata);
+    if (position < 0 || position > source->size()) {
+        return 1;
+    }
+    source->position = position;
+    return 0;
+}
+
+static heif_reader_grow_status source_wait_for_file_size(int64_t target_size, void* userdata) {
+    // All sources have a known, fixed size
+    return target_size <= static_cast<ByteSource*>(userdata)->size()
+               ? heif_reader_grow_status_size_reached
+               : heif_reader_grow_status_size_beyond_eof;
+}
+
+const heif_reader* byte_source_reader() {
+    static const heif_reader reader = [] {
+        heif_reader r = {};
+        r.reader_api_version = 1;
+        r.get_position = source_get_position;
+        r.read = source_read;
+        r.seek = source_seek;
+        r.wait_for_file_size = source_wait_for_file_size;
+        return r;
+    }();
+    return &reader;
+}
+
+FileSource::FileSource(const std::string& path) {
+    file = fopen(path.c_str(), "rb");
+    if (!file) {
+        heif_error err = {heif_error_Input_does_not_exist, heif_suberror_Unspecified,
+                          "Cannot open file"};
+        throw HeifError(err);
+    }
+    if (pylibheif_fseek(file, 0, SEEK_END) == 0) {
+        file_size = pylibheif_ftell(file);
+    }
+    file_position = -1;
+}
+
+FileSource::~FileSource() {
+    if (file) {
+        fclose(file);
+    }
+}
+
+bool FileSource::read_at(void* data, size_t size, int64_t position) {
+    // Sequential reads (the common case) skip the seek
+    if (position != file_position && pylibheif_fseek(file, position, SEEK_SET) != 0) {
+        file_position = -1;
+        return false;
+    }
+    size_t n = fread(data, 1, size, file);
+    file_position = n == size ? position + static_cast<int64_t>(size) : -1;
+    return n == size;
+}
+
+bool MemorySource::read_at(void* out, size_t size, int64_t position) {
+    memcpy(out, data + position, size);
+    return true;
+}
+
+#ifndef _WIN32
+MmapSource::MmapSource(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        heif_error err = {heif_error_Input_does_not_exist, heif_suberror_Unspecified,
+                          "Cannot open file"};
+        throw HeifError(err);
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            map = static_cast<uint8_t*>(addr);
+            map_size = st.st_size;
+            // libheif jumps between boxes and items; readahead would pull in unused mdat data
+            madvise(map, static_cast<size_t>(map_size), MADV_RANDOM);
+        }
+    }
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+    if (!map) {
+        heif_error err = {heif_error_Input_does_not_exist, heif_suberror_Unspecified,
+                          "Cannot map file"};
+        throw HeifError(err);
+    }
+}
+
+MmapSource::~MmapSource() {
+    if (map) {
+        munmap(map, static_cast<size_t>(map_size));
+    }
+}
+
+bool MmapSource::read_at(void* data, size_t size, int64_t position) {
+    // Prefetch the whole requested range in one go instead of faulting page by page
+    static const int64_t page = sysconf(_SC_PAGESIZE);
+    const int64_t begin = position / page * page;
+    madvise(map + begin, static_cast<size_t>(position + static_cast<int64_t>(size) - begin),
+            MADV_WILLNEED);
+    memcpy(data, map + position, size);
+    return true;
+}
+#endif
+
+PythonStreamSource::PythonStreamSource(const py::object& fileobj)
+    : readinto(fileobj.attr("readinto")), seek(fileobj.attr("seek")) {
+    stream_size = seek(0, 2).cast<int64_t>();
+    stream_position = stream_size;
+}
+
+bool PythonStreamSource::read_at(void* data, size_t size, int64_t position) {
+    py::gil_scoped_acquire acquire;
+    try {
+        if (position != stream_position) {
+            seek(position);
+            stream_position = position;
+        }
+        char* out = static_cast<char*>(data);
+        size_t done = 0;
+        while (done < size) {
+            // readinto fills the destination directly; no intermediate bytes object
+            py::memoryview view = py::memoryview::from_memory(
+                out + done, static_cast<py::ssize_t>(size - done), false);
+            ReleaseViewGuard guard{view, "pylibheif: releasing the readinto() buffer"};
+            py::object n = readinto(view);
+            if (n.is_none() || n.cast<size_t>() == 0) {
+                throw std::runtime_error("readinto() returned no data");
+            }
+            done += n.cast<size_t>();
+            stream_position += static_cast<int64_t>(n.cast<size_t>());
+        }
+    } catch (...) {
+        if (!error) {
+            error = std::current_exception();
+        }
+        stream_position = -1;
+        return false;
+    }
+    return true;
+}
+
+}  // namespace pylibheif
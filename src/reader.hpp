@@ -0,0 +1,114 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <string>
+
+#include "common.hpp"
+
+// 64-bit stdio seeks
+#ifdef _WIN32
+#define pylibheif_fseek _fseeki64
+#define pylibheif_ftell _ftelli64
+#else
+#define pylibheif_fseek fseeko
+#define pylibheif_ftell ftello
+#endif
+
+namespace pylibheif {
+
+// Random-access byte source handed to libheif through heif_reader callbacks, so only the
+// ranges libheif asks for are read. Counts the bytes actually delivered.
+class ByteSource {
+   public:
+    virtual ~ByteSource() = default;
+
+    virtual int64_t size() const = 0;
+    // Reads exactly `size` bytes at `position`; returns false on failure
+    virtual bool read_at(void* data, size_t size, int64_t position) = 0;
+
+    int64_t position = 0;
+    uint64_t bytes_read = 0;
+};
+
+// heif_reader whose userdata is a ByteSource*; the table is static and never freed
+const heif_reader* byte_source_reader();
+
+// Reads a file through stdio with 64-bit offsets
+class FileSource : public ByteSource {
+   public:
+    explicit FileSource(const std::string& path);
+    ~FileSource() override;
+
+    FileSource(const FileSource&) = delete;
+    FileSource& operator=(const FileSource&) = delete;
+
+    int64_t size() const override { return file_size; }
+    bool read_at(void* data, size_t size, int64_t position) override;
+
+   private:
+    FILE* file = nullptr;
+    int64_t file_size = 0;
+    int64_t file_position = 0;
+};
+
+// Reads from memory owned by someone else (e.g. an exported Python buffer)
+class MemorySource : public ByteSource {
+   public:
+    MemorySource(const void* data, size_t size)
+        : data(static_cast<const uint8_t*>(data)), data_size(static_cast<int64_t>(size)) {}
+
+    int64_t size() const override { return data_size; }
+    bool read_at(void* out, size_t size, int64_t position) override;
+
+   private:
+    const uint8_t* data;
+    int64_t data_size;
+};
+
+// Reads through a read-only memory map of the file (POSIX). Pages are only faulted in for
+// the ranges libheif requests; readahead is disabled and requested ranges are prefetched.
+// On Windows this falls back to stdio reads.
+#ifndef _WIN32
+class MmapSource : public ByteSource {
+   public:
+    explicit MmapSource(const std::string& path);
+    ~MmapSource() override;
+
+    MmapSource(const MmapSource&) = delete;
+    MmapSource& operator=(const MmapSource&) = delete;
+
+    int64_t size() const override { return map_size; }
+    bool read_at(void* data, size_t size, int64_t position) override;
+
+   private:
+    uint8_t* map = nullptr;
+    int64_t map_size = 0;
+};
+#else
+class MmapSource : public FileSource {
+   public:
+    using FileSource::FileSource;
+};
+#endif
+
+// Reads from a seekable Python binary file object via readinto()/seek(). The GIL is only
+// taken inside read_at, so libheif itself runs without it. Must be destroyed with the GIL.
+class PythonStreamSource : public ByteSource {
+   public:
+    explicit PythonStreamSource(const py::object& fileobj);
+
+    int64_t size() const override { return stream_size; }
+    bool read_at(void* data, size_t size, int64_t position) override;
+
+    // First Python exception raised inside read_at, if any
+    std::exception_ptr error;
+
+   private:
+    py::object readinto;
+    py::object seek;
+    int64_t stream_size = 0;
+    int64_t stream_position = 0;
+};
+
+}  // namespace pylibheif
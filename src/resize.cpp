@@ -0,0 +1,214 @@
+#include "resize.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "image.hpp"
+#include "pool.hpp"
+#include "stats.hpp"
+
+namespace pylibheif {
+
+// Source taps and weights of every output sample along one axis
+struct AxisWeights {
+    std::vector<int> start;
+    std::vector<int> count;
+    std::vector<float> weights;  // count[i] weights of output sample i start at offset[i]
+    std::vector<size_t> offset;
+};
+
+static AxisWeights compute_weights(int src_len, int dst_len) {
+    AxisWeights axis;
+    axis.start.resize(dst_len);
+    axis.count.resize(dst_len);
+    axis.offset.resize(dst_len);
+
+    const double scale = static_cast<double>(src_len) / dst_len;
+    for (int i = 0; i < dst_len; ++i) {
+        const double begin = i * scale;
+        const double end = std::min<double>((i + 1) * scale, src_len);
+        int first = std::min(static_cast<int>(std::floor(begin)), src_len - 1);
+        int last = std::max(first + 1, static_cast<int>(std::ceil(end)));
+
+        axis.start[i] = first;
+        axis.offset[i] = axis.weights.size();
+        double total = 0;
+        for (int s = first; s < last; ++s) {
+            double w = std::min<double>(s + 1, end) - std::max<double>(s, begin);
+            axis.weights.push_back(static_cast<float>(std::max(w, 0.0)));
+            total += std::max(w, 0.0);
+        }
+        // Normalize so that a flat input stays flat despite rounding of the overlaps
+        for (size_t k = axis.offset[i]; k < axis.weights.size(); ++k) {
+            axis.weights[k] = total > 0 ? static_cast<float>(axis.weights[k] / total) : 0.f;
+        }
+        axis.count[i] = last - first;
+    }
+    return axis;
+}
+
+// The vertical pass is a plain multiply-add over whole rows that compilers auto-vectorize
+PYLIBHEIF_TARGET_CLONES
+static void accumulate_row_u8(const uint8_t* src, float weight, float* acc, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        acc[i] += weight * static_cast<float>(src[i]);
+    }
+}
+
+PYLIBHEIF_TARGET_CLONES
+static void accumulate_row_u16(const uint16_t* src, float weight, float* acc, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        acc[i] += weight * static_cast<float>(src[i]);
+    }
+}
+
+static inline void accumulate_row(const uint8_t* src, float weight, float* acc, size_t n) {
+    accumulate_row_u8(src, weight, acc, n);
+}
+
+static inline void accumulate_row(const uint16_t* src, float weight, float* acc, size_t n) {
+    accumulate_row_u16(src, weight, acc, n);
+}
+
+// Vertical pass into a float row, then horizontal pass per output pixel
+template <typename T>
+static void resize_plane(const T* src, size_t src_stride, int src_width, int src_height,
+                         T* dst, size_t dst_stride, int dst_width, int dst_height, int channels,
+                         float max_value) {
+    const AxisWeights wx = compute_weights(src_width, dst_width);
+    const AxisWeights wy = compute_weights(src_height, dst_height);
+    const size_t row_len = static_cast<size_t>(src_width) * channels;
+    std::vector<float> acc(row_len);
+
+    for (int y = 0; y < dst_height; ++y) {
+        std::fill(acc.begin(), acc.end(), 0.f);
+        for (int k = 0; k < wy.count[y]; ++k) {
+            const T* row = reinterpret_cast<const T*>(reinterpret_cast<const uint8_t*>(src) +
+                                                      (wy.start[y] + k) * src_stride);
+            accumulate_row(row, wy.weights[wy.offset[y] + k], acc.data(), row_len);
+        }
+
+        T* out = reinterpret_cast<T*>(reinterpret_cast<uint8_t*>(dst) + y * dst_stride);
+        for (int x = 0; x < dst_width; ++x) {
+            const float* taps = acc.data() + static_cast<size_t>(wx.start[x]) * channels;
+            const float* weights = wx.weights.data() + wx.offset[x];
+            for (int c = 0; c < channels; ++c) {
+                float sum = 0.f;
+                for (int k = 0; k < wx.count[x]; ++k) {
+                    sum += weights[k] * taps[k * channels + c];
+                }
+                out[x * channels + c] = static_cast<T>(std::min(sum + 0.5f, max_value));
+            }
+        }
+    }
+}
+
+void resize_plane_u8(const uint8_t* src, size_t src_stride, int src_width, int src_height,
+                     uint8_t* dst, size_t dst_stride, int dst_width, int dst_height,
+                     int channels) {
+    resize_plane(src, src_stride, src_width, src_height, dst, dst_stride, dst_width, dst_height,
+                 channels, 255.f);
+}
+
+void resize_plane_u16(const uint16_t* src, size_t src_stride, int src_width, int src_height,
+                      uint16_t* dst, size_t dst_stride, int dst_width, int dst_height,
+                      int channels, uint16_t max_value) {
+    resize_plane(src, src_stride, src_width, src_height, dst, dst_stride, dst_width, dst_height,
+                 channels, static_cast<float>(max_value));
+}
+
+void fit_within(int width, int height, int max_width, int max_height, int& out_width,
+                int& out_height) {
+    double scale = 1.0;
+    if (max_width > 0 && width > max_width) {
+        scale = std::min(scale, static_cast<double>(max_width) / width);
+    }
+    if (max_height > 0 && height > max_height) {
+        scale = std::min(scale, static_cast<double>(max_height) / height);
+    }
+    out_width = std::clamp(static_cast<int>(std::lround(width * scale)), 1, width);
+    out_height = std::clamp(static_cast<int>(std::lround(height * scale)), 1, height);
+}
+
+heif_image* downscale_image(const heif_image* img, int width, int height) {
+    ScopedTimer timer(Stage::Downscale);
+    const heif_chroma chroma = heif_image_get_chroma_format(img);
+
+    // Interleaved 16-bit samples in foreign byte order cannot be filtered as integers
+    const bool foreign_endian =
+        host_is_little_endian()
+            ? (chroma == heif_chroma_interleaved_RRGGBB_BE ||
+               chroma == heif_chroma_interleaved_RRGGBBAA_BE)
+            : (chroma == heif_chroma_interleaved_RRGGBB_LE ||
+               chroma == heif_chroma_interleaved_RRGGBBAA_LE);
+    if (foreign_endian) {
+        heif_image* scaled;
+        check_error(heif_image_scale_image(img, &scaled, width, height, nullptr));
+        copy_color_profiles(img, scaled);
+        if (timer.enabled()) {
+            timer.add_bytes(image_bytes(scaled));
+        }
+        return scaled;
+    }
+
+    const int src_width = heif_image_get_primary_width(img);
+    const int src_height = heif_image_get_primary_height(img);
+    std::vector<PlaneSpec> planes;
+    for (heif_channel channel : kAllChannels) {
+        if (!heif_image_has_channel(img, channel)) {
+            continue;
+        }
+        const int plane_src_w = heif_image_get_width(img, channel);
+        const int plane_src_h = heif_image_get_height(img, channel);
+        // Subsampled planes keep their ratio to the primary size, rounded up
+        const int plane_dst_w = plane_src_w == src_width
+                                    ? width
+                                    : (width * plane_src_w + src_width - 1) / src_width;
+        const int plane_dst_h = plane_src_h == src_height
+                                    ? height
+                                    : (height * plane_src_h + src_height - 1) / src_height;
+        planes.push_back({channel, plane_dst_w, plane_dst_h,
+                          heif_image_get_bits_per_pixel_range(img, channel)});
+    }
+
+    heif_image* out =
+        acquire_image(width, height, heif_image_get_colorspace(img), chroma, planes,
+                      color_profile_key(img));
+
+    try {
+        for (const PlaneSpec& plane : planes) {
+            const heif_channel channel = plane.channel;
+            const int plane_src_w = heif_image_get_width(img, channel);
+            const int plane_src_h = heif_image_get_height(img, channel);
+            const int plane_dst_w = plane.width;
+            const int plane_dst_h = plane.height;
+            const int bits = plane.bits;
+
+            int src_stride, dst_stride;
+            const uint8_t* src = heif_image_get_plane_readonly(img, channel, &src_stride);
+            uint8_t* dst = heif_image_get_plane(out, channel, &dst_stride);
+
+            const int bytes_per_pixel = describe_plane(img, channel).bytes_per_pixel();
+            if (bits <= 8) {
+                resize_plane_u8(src, src_stride, plane_src_w, plane_src_h, dst, dst_stride,
+                                plane_dst_w, plane_dst_h, bytes_per_pixel);
+            } else {
+                resize_plane_u16(reinterpret_cast<const uint16_t*>(src), src_stride,
+                                 plane_src_w, plane_src_h, reinterpret_cast<uint16_t*>(dst),
+                                 dst_stride, plane_dst_w, plane_dst_h, bytes_per_pixel / 2,
+                                 static_cast<uint16_t>((1u << bits) - 1));
+            }
+        }
+        copy_color_profiles(img, out);
+    } catch (...) {
+        heif_image_release(out);
+        throw;
+    }
+    if (timer.enabled()) {
+        timer.add_bytes(image_bytes(out));
+    }
+    return out;
+}
+
+}  // namespace pylibheif
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "common.hpp"
+
+namespace pylibheif {
+
+// Area-averaging (box) downscale of one image plane with `channels` interleaved samples per
+// pixel. Strides are in bytes. Samples are clamped to max_value; pure C++ so it can run
+// without the GIL.
+void resize_plane_u8(const uint8_t* src, size_t src_stride, int src_width, int src_height,
+                     uint8_t* dst, size_t dst_stride, int dst_width, int dst_height,
+                     int channels);
+void resize_plane_u16(const uint16_t* src, size_t src_stride, int src_width, int src_height,
+                      uint16_t* dst, size_t dst_stride, int dst_width, int dst_height,
+                      int channels, uint16_t max_value);
+
+// Returns a width x height copy of img with the same colorspace, chroma, bit depth and
+// color profiles. Every plane (including subsampled chroma and alpha) is area-filtered in
+// its own resolution. Throws HeifError on failure.
+heif_image* downscale_image(const heif_image* img, int width, int height);
+
+// Size fitting into max_width x max_height (0 = unbounded) with the aspect ratio kept;
+// never upscales
+void fit_within(int width, int height, int max_width, int max_height, int& out_width,
+                int& out_height);
+
+}  // namespace pylibheif
@@ -0,0 +1,153 @@
+#include "sequence.hpp"
+
+#include <mutex>
+#include <utility>
+
+#include "context.hpp"
+#include "decoder.hpp"
+#include "image.hpp"
+#include "stats.hpp"
+
+namespace pylibheif {
+
+#ifdef PYLIBHEIF_HAVE_SEQUENCES
+
+HeifSequence::HeifSequence(HeifContext& ctx, uint32_t track_id, heif_colorspace colorspace,
+                           heif_chroma chroma, std::shared_ptr<DecodingOptions> options)
+    : colorspace(colorspace), chroma(chroma), options(std::move(options)) {
+    // Track id 0 selects the first visual track
+    check_error(heif_context_get_track(ctx.get(), track_id, &track));
+
+    uint16_t w = 0, h = 0;
+    heif_error err = heif_track_get_image_resolution(track, &w, &h);
+    if (err.code != heif_error_Ok) {
+        heif_track_release(track);
+        track = nullptr;
+        check_error(err);
+    }
+    width = w;
+    height = h;
+    timescale = heif_track_get_timescale(track);
+}
+
+HeifSequence::~HeifSequence() {
+    if (track) {
+        heif_track_release(track);
+    }
+}
+
+uint32_t HeifSequence::get_track_id() const { return heif_track_get_id(track); }
+
+heif_image* HeifSequence::decode_next() {
+    ScopedTimer timer(Stage::Decode);
+    heif_image* img = nullptr;
+    heif_error err = heif_track_decode_next_image(track, &img, colorspace, chroma,
+                                                  options ? options->get() : nullptr);
+    if (err.code == heif_error_End_of_sequence) {
+        return nullptr;
+    }
+    check_error(err);
+    if (timer.enabled()) {
+        timer.add_bytes(image_bytes(img));
+    }
+    return img;
+}
+
+HeifFrame HeifSequence::make_frame(const heif_image* img) {
+    const uint32_t duration = heif_image_get_duration(img);
+    HeifFrame frame;
+    frame.index = frame_index++;
+    if (timescale > 0) {
+        frame.timestamp = static_cast<double>(elapsed) / timescale;
+        frame.duration = static_cast<double>(duration) / timescale;
+    }
+    elapsed += duration;
+    return frame;
+}
+
+std::optional<HeifFrame> HeifSequence::next() {
+    py::gil_scoped_release release;
+    std::lock_guard<std::mutex> lock(mutex);
+    heif_image* img = decode_next();
+    if (!img) {
+        return std::nullopt;
+    }
+    auto image = std::make_shared<HeifImage>(img);
+    HeifFrame frame = make_frame(img);
+    frame.image = std::move(image);
+    return frame;
+}
+
+std::optional<HeifFrame> HeifSequence::next_into(const py::buffer& out) {
+    py::buffer_info info = out.request(true);
+    if (info.readonly) {
+        throw std::invalid_argument("next_into requires a writable buffer");
+    }
+
+    py::gil_scoped_release release;
+    std::lock_guard<std::mutex> lock(mutex);
+    heif_image* img = decode_next();
+    if (!img) {
+        return std::nullopt;
+    }
+    // The decoded frame is released right after the copy, so memory stays flat. Timing
+    // advances first: the sample is consumed even if `out` turns out not to fit.
+    HeifImage image(img);
+    HeifFrame frame = make_frame(img);
+    copy_image_into(image, info);
+    return frame;
+}
+
+uint32_t HeifSequence::skip(uint32_t count) {
+    py::gil_scoped_release release;
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t skipped = 0;
+    // Samples depend on earlier ones, so skipping still has to decode them
+    for (; skipped < count; ++skipped) {
+        heif_image* img = decode_next();
+        if (!img) {
+            break;
+        }
+        make_frame(img);
+        heif_image_release(img);
+    }
+    return skipped;
+}
+
+bool context_has_sequence(HeifContext& ctx) { return heif_context_has_sequence(ctx.get()) != 0; }
+
+std::vector<uint32_t> context_track_ids(HeifContext& ctx) {
+    std::vector<uint32_t> ids(heif_context_number_of_sequence_tracks(ctx.get()));
+    if (!ids.empty()) {
+        heif_context_get_track_ids(ctx.get(), ids.data());
+    }
+    return ids;
+}
+
+#else
+
+static void throw_no_sequences() {
+    heif_error err = {heif_error_Unsupported_feature, heif_suberror_Unspecified,
+                      "Image sequences require libheif 1.20 or newer"};
+    throw HeifError(err);
+}
+
+HeifSequence::HeifSequence(HeifContext&, uint32_t, heif_colorspace colorspace, heif_chroma chroma,
+                           std::shared_ptr<DecodingOptions> options)
+    : colorspace(colorspace), chroma(chroma), options(std::move(options)) {
+    throw_no_sequences();
+}
+
+HeifSequence::~HeifSequence() = default;
+uint32_t HeifSequence::get_track_id() const { return 0; }
+heif_image* HeifSequence::decode_next() { return nullptr; }
+HeifFrame HeifSequence::make_frame(const heif_image*) { return {}; }
+std::optional<HeifFrame> HeifSequence::next() { return std::nullopt; }
+std::optional<HeifFrame> HeifSequence::next_into(const py::buffer&) { return std::nullopt; }
+uint32_t HeifSequence::skip(uint32_t) { return 0; }
+bool context_has_sequence(HeifContext&) { return false; }
+std::vector<uint32_t> context_track_ids(HeifContext&) { return {}; }
+
+#endif
+
+}  // namespace pylibheif
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "common.hpp"
+
+// Image sequences (msf1 / AVIF animations) are tracks, available since libheif 1.20
+#if LIBHEIF_HAVE_VERSION(1, 20, 0)
+#include <libheif/heif_sequences.h>
+#define PYLIBHEIF_HAVE_SEQUENCES 1
+#else
+struct heif_track;
+#endif
+
+namespace pylibheif {
+
+class DecodingOptions;
+class HeifContext;
+class HeifImage;
+
+// One decoded frame; image is null when the pixels went into a caller buffer
+struct HeifFrame {
+    std::shared_ptr<HeifImage> image;
+    uint32_t index = 0;
+    double timestamp = 0;  // Seconds since the start of the track
+    double duration = 0;   // Seconds
+};
+
+// Decodes frames of one visual track in presentation order. libheif keeps the read
+// position in the track itself, so a track is iterated once per context. Concurrent
+// next() calls are safe; each frame goes to exactly one caller.
+class HeifSequence {
+   public:
+    HeifSequence(HeifContext& ctx, uint32_t track_id, heif_colorspace colorspace,
+                 heif_chroma chroma, std::shared_ptr<DecodingOptions> options);
+    ~HeifSequence();
+
+    HeifSequence(const HeifSequence&) = delete;
+    HeifSequence& operator=(const HeifSequence&) = delete;
+
+    uint32_t get_track_id() const;
+    int get_width() const { return width; }
+    int get_height() const { return height; }
+    uint32_t get_timescale() const { return timescale; }
+
+    // Next frame, or nullopt at the end of the track
+    std::optional<HeifFrame> next();
+    // Decodes the next frame into a caller-owned (height, width[, channels]) buffer, so one
+    // buffer is reused across the whole track; nullopt at the end
+    std::optional<HeifFrame> next_into(const py::buffer& out);
+    // Decodes and drops up to `count` frames; returns how many were skipped
+    uint32_t skip(uint32_t count);
+
+   private:
+    // Decodes the next raw frame without the GIL; null at the end of the track
+    heif_image* decode_next();
+    HeifFrame make_frame(const heif_image* img);
+
+    heif_track* track = nullptr;
+    heif_colorspace colorspace;
+    heif_chroma chroma;
+    // Kept alive (and read) by every decode of the track
+    std::shared_ptr<DecodingOptions> options;
+    int width = 0;
+    int height = 0;
+    uint32_t timescale = 0;
+    // Decodes run without the GIL, so this serializes the track's read position with
+    // frame_index and elapsed when several threads pull frames from one sequence
+    std::mutex mutex;
+    uint32_t frame_index = 0;
+    uint64_t elapsed = 0;  // In timescale units
+};
+
+bool context_has_sequence(HeifContext& ctx);
+std::vector<uint32_t> context_track_ids(HeifContext& ctx);
+
+}  // namespace pylibheif
@@ -0,0 +1,121 @@
+#include "stats.hpp"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include <pybind11/stl.h>
+
+#include "image.hpp"
+
+namespace pylibheif {
+
+static const char* const kStageNames[] = {"read",   "decode", "downscale", "allocate",
+                                          "export", "encode", "serialize"};
+static_assert(sizeof(kStageNames) / sizeof(kStageNames[0]) == size_t(Stage::Count),
+              "every stage needs a name");
+
+struct StageCounters {
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> errors{0};
+    std::atomic<uint64_t> total_ns{0};
+    std::atomic<uint64_t> max_ns{0};
+    std::atomic<uint64_t> bytes{0};
+};
+
+// Stage counters are lock-free so concurrent workers do not serialize on the registry;
+// only the (rare) plugin map takes the mutex
+struct StatsRegistry {
+    std::atomic<bool> enabled{false};
+    StageCounters stages[size_t(Stage::Count)];
+    std::mutex mutex;
+    std::map<std::string, uint64_t> plugins;
+};
+
+static StatsRegistry& registry() {
+    static StatsRegistry instance;
+    return instance;
+}
+
+void enable_stats(bool enabled) { registry().enabled.store(enabled, std::memory_order_relaxed); }
+
+bool stats_enabled() { return registry().enabled.load(std::memory_order_relaxed); }
+
+void reset_stats() {
+    StatsRegistry& r = registry();
+    for (StageCounters& s : r.stages) {
+        s.calls = 0;
+        s.errors = 0;
+        s.total_ns = 0;
+        s.max_ns = 0;
+        s.bytes = 0;
+    }
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.plugins.clear();
+}
+
+void record_stage(Stage stage, uint64_t nanoseconds, uint64_t bytes, bool failed) {
+    StageCounters& s = registry().stages[size_t(stage)];
+    s.calls.fetch_add(1, std::memory_order_relaxed);
+    s.total_ns.fetch_add(nanoseconds, std::memory_order_relaxed);
+    s.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    if (failed) {
+        s.errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    uint64_t previous = s.max_ns.load(std::memory_order_relaxed);
+    while (previous < nanoseconds &&
+           !s.max_ns.compare_exchange_weak(previous, nanoseconds, std::memory_order_relaxed)) {
+    }
+}
+
+void record_plugin(const char* kind, const char* name) {
+    if (!stats_enabled()) {
+        return;
+    }
+    StatsRegistry& r = registry();
+    std::string key = std::string(kind) + ":" + (name ? name : "unknown");
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.plugins[key]++;
+}
+
+uint64_t image_bytes(const heif_image* image) {
+    uint64_t total = 0;
+    for (heif_channel channel : kAllChannels) {
+        if (heif_image_has_channel(image, channel)) {
+            int stride;
+            heif_image_get_plane_readonly(image, channel, &stride);
+            total += uint64_t(stride) * heif_image_get_height(image, channel);
+        }
+    }
+    return total;
+}
+
+py::dict get_stats() {
+    StatsRegistry& r = registry();
+    py::dict stages;
+    for (size_t i = 0; i < size_t(Stage::Count); ++i) {
+        const StageCounters& s = r.stages[i];
+        py::dict entry;
+        entry["calls"] = s.calls.load(std::memory_order_relaxed);
+        entry["errors"] = s.errors.load(std::memory_order_relaxed);
+        entry["total_ms"] = s.total_ns.load(std::memory_order_relaxed) / 1e6;
+        entry["max_ms"] = s.max_ns.load(std::memory_order_relaxed) / 1e6;
+        entry["bytes"] = s.bytes.load(std::memory_order_relaxed);
+        stages[kStageNames[i]] = entry;
+    }
+
+    std::map<std::string, uint64_t> plugins;
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        plugins = r.plugins;
+    }
+
+    py::dict result;
+    result["enabled"] = stats_enabled();
+    result["stages"] = stages;
+    result["plugins"] = plugins;
+    return result;
+}
+
+}  // namespace pylibheif
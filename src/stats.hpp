@@ -0,0 +1,72 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <exception>
+
+#include "common.hpp"
+
+namespace pylibheif {
+
+// Pipeline stages timed by the stats registry
+enum class Stage {
+    Read,       // Container parsing (heif_context_read_*)
+    Decode,     // Bitstream decoding including libheif's color conversion
+    Downscale,  // Area-filter previews
+    Allocate,   // Images allocated by pylibheif (pool hits included)
+    Export,     // Pixel copies between heif_image planes and caller buffers
+    Encode,     // heif_context_encode_image (and thumbnails)
+    Serialize,  // heif_context_write
+    Count
+};
+
+// Opt-in, process-wide and thread-safe registry of per-stage timings and byte counters.
+// Disabled by default; a disabled registry costs one relaxed atomic load per stage.
+void enable_stats(bool enabled);
+bool stats_enabled();
+void reset_stats();
+// {"enabled": bool, "stages": {name: {"calls", "errors", "total_ms", "max_ms", "bytes"}},
+//  "plugins": {"encoder:<name>" | "decoder:<id>": calls}}. Needs the GIL.
+py::dict get_stats();
+
+void record_stage(Stage stage, uint64_t nanoseconds, uint64_t bytes, bool failed);
+// Counts one use of a codec plugin; no-op while stats are disabled
+void record_plugin(const char* kind, const char* name);
+
+// Total size in bytes of every plane of an image
+uint64_t image_bytes(const heif_image* image);
+
+// Times a stage from construction to destruction on the steady clock. A stage left through
+// an exception is counted as an error. Does not need the GIL.
+class ScopedTimer {
+   public:
+    explicit ScopedTimer(Stage stage)
+        : stage(stage), active(stats_enabled()), exceptions(std::uncaught_exceptions()) {
+        if (active) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+    ~ScopedTimer() {
+        if (active) {
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+            record_stage(stage,
+                         std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                         bytes, std::uncaught_exceptions() > exceptions);
+        }
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    // Whether this stage is being recorded; lets callers skip work only needed for counters
+    bool enabled() const { return active; }
+    void add_bytes(uint64_t n) { bytes += n; }
+
+   private:
+    Stage stage;
+    bool active;
+    int exceptions;
+    std::chrono::steady_clock::time_point start;
+    uint64_t bytes = 0;
+};
+
+}  // namespace pylibheif
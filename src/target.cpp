@@ -0,0 +1,103 @@
+#include "target.hpp"
+
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "batch.hpp"
+#include "context.hpp"
+#include "encoder.hpp"
+#include "image.hpp"
+#include "metrics.hpp"
+
+namespace pylibheif {
+
+struct Attempt {
+    int quality;
+    double score;
+    std::vector<uint8_t> data;
+};
+
+// Encodes at one quality and scores the decoded result. Does not need the GIL.
+static Attempt encode_and_score(HeifEncoder& encoder, const HeifImage& image, int quality,
+                                QualityMetric metric, const EncodingOptions* options,
+                                const CancelToken* cancel) {
+    Attempt attempt{quality, 0, {}};
+    encoder.set_lossy_quality(quality);
+    {
+        ContextPtr ctx(heif_context_alloc());
+        HandlePtr encoded(encoder.encode(ctx.get(), image, options, cancel));
+        write_context_to_vector(ctx.get(), attempt.data);
+    }
+
+    // libheif only decodes parsed files, so the in-memory result is read back in place
+    ContextPtr ctx(heif_context_alloc());
+    check_error(heif_context_read_from_memory_without_copy(ctx.get(), attempt.data.data(),
+                                                           attempt.data.size(), nullptr));
+    heif_image_handle* raw_handle;
+    check_error(heif_context_get_primary_image_handle(ctx.get(), &raw_handle));
+    HandlePtr handle(raw_handle);
+
+    // Orientation written by the encoding options must not rotate the comparison
+    std::unique_ptr<heif_decoding_options, decltype(&heif_decoding_options_free)> decoding(
+        heif_decoding_options_alloc(), heif_decoding_options_free);
+    decoding->ignore_transformations = 1;
+
+    const heif_image* source = image.get();
+    heif_image* raw_decoded;
+    check_error(heif_decode_image(raw_handle, &raw_decoded, heif_image_get_colorspace(source),
+                                  heif_image_get_chroma_format(source), decoding.get()));
+    ImagePtr decoded(raw_decoded);
+    attempt.score = compare_images(source, raw_decoded, metric);
+    return attempt;
+}
+
+TargetEncoding encode_to_target(const HeifImage& image, heif_compression_format format,
+                                const std::string& metric, double target, int min_quality,
+                                int max_quality, int max_attempts, const py::dict& params,
+                                const EncodingOptions* options, const CancelToken* cancel) {
+    const QualityMetric kind = parse_quality_metric(metric);
+    if (min_quality < 0 || max_quality > 100 || min_quality > max_quality) {
+        throw std::invalid_argument("Quality range must satisfy 0 <= min_quality <= max_quality "
+                                    "<= 100");
+    }
+    if (max_attempts < 1) {
+        throw std::invalid_argument("max_attempts must be >= 1");
+    }
+
+    EncoderConfig config{format, -1, encoder_params_from_dict(params), ""};
+    std::unique_ptr<HeifEncoder> encoder = make_encoder(config);
+
+    std::optional<Attempt> passed;  // Lowest quality reaching the target so far
+    std::optional<Attempt> failed;  // Highest quality below the target so far
+    int attempts = 0;
+    {
+        py::gil_scoped_release release;
+        int lo = min_quality;
+        int hi = max_quality;
+        while (lo <= hi && attempts < max_attempts) {
+            const int quality = lo + (hi - lo) / 2;
+            Attempt attempt = encode_and_score(*encoder, image, quality, kind, options, cancel);
+            ++attempts;
+            if (attempt.score >= target) {
+                hi = quality - 1;
+                passed = std::move(attempt);
+            } else {
+                lo = quality + 1;
+                failed = std::move(attempt);
+            }
+        }
+        encoder.reset();
+    }
+
+    Attempt& chosen = passed ? *passed : *failed;
+    TargetEncoding result;
+    result.data = py::bytes(reinterpret_cast<const char*>(chosen.data.data()), chosen.data.size());
+    result.quality = chosen.quality;
+    result.score = chosen.score;
+    result.attempts = attempts;
+    result.reached = passed.has_value();
+    return result;
+}
+
+}  // namespace pylibheif
@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+
+#include "common.hpp"
+
+namespace pylibheif {
+
+class CancelToken;
+class EncodingOptions;
+class HeifImage;
+
+struct TargetEncoding {
+    py::bytes data;        // Encoded file of the chosen attempt
+    int quality = 0;       // Lossy quality that produced it
+    double score = 0;      // Metric of the decoded result against the source
+    int attempts = 0;      // Encodes performed
+    bool reached = false;  // False if even the best attempt stayed below the target
+};
+
+// Bisects the lossy quality in [min_quality, max_quality] for the lowest value whose decoded
+// result scores at least `target` ("ssim" or "psnr" in dB) against `image`. One encoder is
+// configured once and reused; encoding, decoding and scoring run in native code without the
+// GIL. If no attempt reaches the target, the highest-quality attempt is returned. `cancel` is
+// checked before every attempt.
+TargetEncoding encode_to_target(const HeifImage& image, heif_compression_format format,
+                                const std::string& metric, double target, int min_quality,
+                                int max_quality, int max_attempts, const py::dict& params,
+                                const EncodingOptions* options, const CancelToken* cancel);
+
+}  // namespace pylibheif
@@ -0,0 +1,71 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace pylibheif {
+
+// Number of workers to use for `count` jobs when the caller asked for `threads`
+// (0 or negative = one per hardware thread)
+inline size_t resolve_thread_count(int threads, size_t count) {
+    size_t n = threads > 0 ? static_cast<size_t>(threads) : std::thread::hardware_concurrency();
+    return std::max<size_t>(1, std::min(n, count));
+}
+
+// Runs fn(worker, index) for every index in [0, count) on `workers` threads, where worker is
+// in [0, workers) and stable for the thread running the job. Jobs are handed out dynamically
+// so uneven work (e.g. mixed image sizes) balances out. fn must not throw; callers capture
+// per-job errors themselves. The calling thread participates as worker 0.
+template <typename Fn>
+void parallel_for_workers(size_t count, size_t workers, Fn&& fn) {
+    if (count == 0) {
+        return;
+    }
+    if (workers <= 1) {
+        for (size_t i = 0; i < count; ++i) {
+            fn(size_t{0}, i);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next{0};
+    auto run = [&](size_t worker) {
+        for (size_t i = next++; i < count; i = next++) {
+            fn(worker, i);
+        }
+    };
+
+    // Joins on every exit path; a joinable std::thread must never be destroyed
+    struct Joiner {
+        std::vector<std::thread> threads;
+        ~Joiner() {
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        }
+    } pool;
+    pool.threads.reserve(workers - 1);
+    for (size_t t = 1; t < workers; ++t) {
+        try {
+            pool.threads.emplace_back(run, t);
+        } catch (const std::system_error&) {
+            // Out of threads (process or container limit): the ones already started, plus
+            // this one, still drain the whole range
+            break;
+        }
+    }
+    run(0);
+}
+
+// Runs fn(index) for every index in [0, count) on up to `threads` workers. Must be called
+// without the GIL if fn does heavy work.
+template <typename Fn>
+void parallel_for(size_t count, int threads, Fn&& fn) {
+    parallel_for_workers(count, resolve_thread_count(threads, count),
+                         [&](size_t, size_t i) { fn(i); });
+}
+
+}  // namespace pylibheif
@@ -0,0 +1,95 @@
+#include "transcode.hpp"
+
+#include <string>
+#include <vector>
+
+#include "batch.hpp"
+#include "context.hpp"
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "image.hpp"
+#include "resize.hpp"
+
+namespace pylibheif {
+
+// Copies the Exif, XMP and other metadata blocks of src onto dst
+static void copy_metadata_blocks(const heif_image_handle* src, heif_context* ctx,
+                                 heif_image_handle* dst) {
+    int count = heif_image_handle_get_number_of_metadata_blocks(src, nullptr);
+    std::vector<heif_item_id> ids(count);
+    heif_image_handle_get_list_of_metadata_block_IDs(src, nullptr, ids.data(), count);
+
+    for (heif_item_id id : ids) {
+        std::string type = heif_image_handle_get_metadata_type(src, id);
+        std::string content_type = heif_image_handle_get_metadata_content_type(src, id);
+        std::vector<uint8_t> data(heif_image_handle_get_metadata_size(src, id));
+        check_error(heif_image_handle_get_metadata(src, id, data.data()));
+
+        if (type == "Exif") {
+            // Stored Exif starts with a 4-byte offset to the TIFF header, which libheif
+            // writes again when adding the block
+            size_t skip = 4;
+            if (data.size() >= 4) {
+                skip += (size_t(data[0]) << 24) | (size_t(data[1]) << 16) |
+                        (size_t(data[2]) << 8) | size_t(data[3]);
+            }
+            if (skip >= data.size()) {
+                continue;
+            }
+            check_error(heif_context_add_exif_metadata(ctx, dst, data.data() + skip,
+                                                       static_cast<int>(data.size() - skip)));
+        } else if (type == "mime" && content_type == "application/rdf+xml") {
+            check_error(heif_context_add_XMP_metadata(ctx, dst, data.data(),
+                                                      static_cast<int>(data.size())));
+        } else {
+            check_error(heif_context_add_generic_metadata(
+                ctx, dst, data.data(), static_cast<int>(data.size()), type.c_str(),
+                content_type.empty() ? nullptr : content_type.c_str()));
+        }
+    }
+}
+
+py::bytes transcode(const py::object& input, heif_compression_format output_format,
+                    int max_size, int quality, const py::dict& params, bool copy_metadata,
+                    const DecodingOptions* options, const CancelToken* cancel) {
+    if (max_size < 0) {
+        throw std::invalid_argument("max_size must be >= 0");
+    }
+    BatchInput source = resolve_input(input, "transcode");
+    EncoderConfig config{output_format, quality, encoder_params_from_dict(params), ""};
+
+    std::vector<uint8_t> output;
+    {
+        py::gil_scoped_release release;
+        DecodeCall call(options, cancel);
+        HandlePtr handle = open_primary(source, -1);
+
+        // Decoding to the native colorspace/chroma keeps YCbCr sources in YCbCr, so no RGB
+        // round trip happens unless the target encoder asks for it
+        heif_image* decoded =
+            call.decode(handle.get(), heif_colorspace_undefined, heif_chroma_undefined);
+        auto image = std::make_shared<HeifImage>(decoded);
+
+        // Native decoding leaves YCbCr planes in place, so the area filter runs on them
+        // before any color conversion
+        const int src_width = heif_image_get_primary_width(decoded);
+        const int src_height = heif_image_get_primary_height(decoded);
+        int width, height;
+        fit_within(src_width, src_height, max_size, max_size, width, height);
+        if (width != src_width || height != src_height) {
+            image = std::make_shared<HeifImage>(downscale_image(decoded, width, height), true);
+        }
+
+        std::unique_ptr<HeifEncoder> encoder = make_encoder(config);
+        ContextPtr ctx(heif_context_alloc());
+        HandlePtr encoded(encoder->encode(ctx.get(), *image, nullptr, cancel));
+        if (copy_metadata) {
+            copy_metadata_blocks(handle.get(), ctx.get(), encoded.get());
+        }
+        write_context_to_vector(ctx.get(), output);
+    }
+
+    return py::bytes(reinterpret_cast<const char*>(output.data()), output.size());
+}
+
+}  // namespace pylibheif
@@ -0,0 +1,17 @@
+#pragma once
+#include "common.hpp"
+
+namespace pylibheif {
+
+class CancelToken;
+class DecodingOptions;
+
+// Decodes the primary image of `input` (path or buffer), downscales it to fit into
+// max_size x max_size (0 = keep size) and re-encodes it with `output_format`, all in the
+// libheif image domain without the GIL. Only the encoded file is returned to Python.
+// `cancel` stops the decode and is checked again before encoding.
+py::bytes transcode(const py::object& input, heif_compression_format output_format,
+                    int max_size, int quality, const py::dict& params, bool copy_metadata,
+                    const DecodingOptions* options, const CancelToken* cancel);
+
+}  // namespace pylibheif
@@ -0,0 +1,176 @@
+#include "work_queue.hpp"
+
+#include <algorithm>
+
+namespace pylibheif {
+
+// Sets the results of one loop's finished jobs; runs on the loop thread
+static void drain_completions(py::dict completions, py::object loop) {
+    py::list items = completions.attr("pop")(loop, py::list());
+    for (py::handle item : items) {
+        py::tuple entry = py::reinterpret_borrow<py::tuple>(item);
+        py::object future = entry[0];
+        // One failing future must not strand the others queued behind it
+        try {
+            // The awaiting task may have been cancelled while the job ran
+            if (future.attr("done")().cast<bool>()) {
+                continue;
+            }
+            if (entry[1].cast<bool>()) {
+                future.attr("set_result")(entry[2]);
+            } else {
+                future.attr("set_exception")(entry[2]);
+            }
+        } catch (py::error_already_set& e) {
+            e.discard_as_unraisable(future);
+        }
+    }
+}
+
+WorkQueue::WorkQueue(int threads) {
+    if (threads < 0) {
+        throw std::invalid_argument("threads must be >= 0");
+    }
+    if (threads == 0) {
+        threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    py::dict pending = completions;
+    drain = py::cpp_function(
+        [pending](py::object loop) { drain_completions(pending, std::move(loop)); });
+
+    workers.reserve(threads);
+    for (int i = 0; i < threads; ++i) {
+        workers.emplace_back([this] { run_worker(); });
+    }
+}
+
+WorkQueue::~WorkQueue() { shutdown(true, false); }
+
+py::object WorkQueue::submit(const py::object& loop, const py::object& func,
+                             const py::args& args, const py::kwargs& kwargs) {
+    py::object future = loop.attr("create_future")();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) {
+            throw std::runtime_error("WorkQueue has been shut down");
+        }
+        jobs.push_back(Job{loop, future, func, args, kwargs});
+    }
+    ready.notify_one();
+    return future;
+}
+
+void WorkQueue::shutdown(bool wait, bool cancel_pending) {
+    std::deque<Job> dropped;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        if (cancel_pending) {
+            dropped.swap(jobs);
+        }
+    }
+    ready.notify_all();
+
+    for (const Job& job : dropped) {
+        try {
+            job.loop.attr("call_soon_threadsafe")(job.future.attr("cancel"));
+        } catch (const py::error_already_set&) {
+            // The loop is already closed; nobody is waiting for the future
+        }
+    }
+    dropped.clear();
+
+    if (wait) {
+        // Workers need the GIL to finish their current job
+        py::gil_scoped_release release;
+        for (std::thread& worker : workers) {
+            if (worker.joinable() && worker.get_id() != std::this_thread::get_id()) {
+                worker.join();
+            }
+        }
+    }
+}
+
+size_t WorkQueue::get_pending() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return jobs.size();
+}
+
+size_t WorkQueue::get_running() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return running;
+}
+
+bool WorkQueue::is_shutdown() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stopping;
+}
+
+void WorkQueue::run_worker() {
+    // One Python thread state for the worker's lifetime: the per-job acquire below reuses it
+    // instead of creating and destroying one for every job
+    py::gil_scoped_acquire thread_state;
+    py::gil_scoped_release idle;
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            running++;
+        }
+
+        {
+            py::gil_scoped_acquire acquire;
+            // Nothing may escape the thread body (that would call std::terminate), and a job
+            // that cannot be completed must not take the worker down with it
+            try {
+                if (!job.future.attr("cancelled")().cast<bool>()) {
+                    py::object value;
+                    bool ok = true;
+                    try {
+                        value = job.func(*job.args, **job.kwargs);
+                    } catch (py::error_already_set& e) {
+                        ok = false;
+                        value = e.value();
+                    }
+                    complete(job, ok, value);
+                }
+            } catch (py::error_already_set& e) {
+                e.discard_as_unraisable(job.future);
+            } catch (const std::exception& e) {
+                PyErr_SetString(PyExc_RuntimeError, e.what());
+                PyErr_WriteUnraisable(job.future.ptr());
+            }
+            // Drop the references while the GIL is held
+            job = Job();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        running--;
+    }
+}
+
+void WorkQueue::complete(const Job& job, bool ok, const py::object& value) {
+    py::tuple entry = py::make_tuple(job.future, ok, value);
+    if (completions.contains(job.loop)) {
+        // A drain is already pending on this loop and will pick the result up
+        completions[job.loop].cast<py::list>().append(entry);
+        return;
+    }
+    py::list items;
+    items.append(entry);
+    completions[job.loop] = items;
+    try {
+        job.loop.attr("call_soon_threadsafe")(drain, job.loop);
+    } catch (const py::error_already_set&) {
+        // Closed loop: the result has nowhere to go
+        PyDict_DelItem(completions.ptr(), job.loop.ptr());
+    }
+}
+
+}  // namespace pylibheif
@@ -0,0 +1,68 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "common.hpp"
+
+namespace pylibheif {
+
+// Dedicated worker pool behind the asyncio wrappers, independent of the event loop's default
+// executor. submit() returns a future of `loop` that a worker completes. Results go back
+// through loop.call_soon_threadsafe, coalesced so that a single loop wakeup delivers every
+// result that finished in the meantime; callers pipeline by keeping many submissions in
+// flight. Jobs are Python callables and run with the GIL, which pylibheif releases around
+// all native work.
+class WorkQueue {
+   public:
+    explicit WorkQueue(int threads = 0);  // 0 = one worker per hardware thread
+    // Runs the queued jobs to completion and joins the workers
+    ~WorkQueue();
+
+    WorkQueue(const WorkQueue&) = delete;
+    WorkQueue& operator=(const WorkQueue&) = delete;
+
+    // Queues func(*args, **kwargs) and returns an asyncio future bound to loop. A future
+    // cancelled before a worker picks the job up skips the call. Needs the GIL.
+    py::object submit(const py::object& loop, const py::object& func, const py::args& args,
+                      const py::kwargs& kwargs);
+
+    // Stops accepting jobs. Queued jobs still run unless cancel_pending, which cancels their
+    // futures instead; wait blocks until the workers have exited. Needs the GIL.
+    void shutdown(bool wait = true, bool cancel_pending = false);
+
+    int get_threads() const { return static_cast<int>(workers.size()); }
+    size_t get_pending() const;  // Jobs waiting for a worker
+    size_t get_running() const;
+    bool is_shutdown() const;
+
+   private:
+    // Plain objects so that an empty Job can be created without the GIL
+    struct Job {
+        py::object loop;
+        py::object future;
+        py::object func;
+        py::object args;    // tuple
+        py::object kwargs;  // dict
+    };
+
+    std::vector<std::thread> workers;
+    mutable std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<Job> jobs;  // Only moved without the GIL, never copied or destroyed
+    size_t running = 0;
+    bool stopping = false;
+
+    // loop -> list of (future, ok, value) waiting for the drain scheduled on that loop; a key
+    // is present exactly while a drain is pending. Guarded by the GIL.
+    py::dict completions;
+    py::object drain;
+
+    void run_worker();
+    void complete(const Job& job, bool ok, const py::object& value);
+};
+
+}  // namespace pylibheif
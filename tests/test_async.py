@@ -89,3 +89,130 @@ class TestAsyncHeif:
             await encoder.encode_image(ctx, img)
             data = await ctx.write_to_bytes()
             assert len(data) > 0
+
+    async def test_async_deadline(self):
+        img = create_dummy_image()
+        ctx = pylibheif.AsyncHeifContext()
+        encoder = pylibheif.AsyncHeifEncoder(pylibheif.HeifCompressionFormat.HEVC)
+        with pytest.raises(pylibheif.HeifError):
+            await encoder.encode_image(ctx, img, deadline_ms=0)
+
+        await encoder.encode_image(ctx, img)
+        data = await ctx.write_to_bytes()
+        with pytest.raises(pylibheif.HeifError):
+            await pylibheif.transcode_async(data, deadline_ms=0)
+
+    async def test_async_deadline_keeps_caller_token(self):
+        img = create_dummy_image()
+        ctx = pylibheif.AsyncHeifContext()
+        encoder = pylibheif.AsyncHeifEncoder(pylibheif.HeifCompressionFormat.HEVC)
+        token = pylibheif.CancelToken()
+        with pytest.raises(pylibheif.HeifError):
+            await encoder.encode_image(ctx, img, cancel=token, deadline_ms=0)
+        assert not token.cancelled
+        assert token.remaining_ms is None
+        await encoder.encode_image(ctx, img, cancel=token)
+
+    async def test_async_cancel_fires_token(self):
+        import asyncio
+
+        img = create_dummy_image(512, 512)
+        token = pylibheif.CancelToken()
+        task = asyncio.ensure_future(
+            pylibheif.encode_batch_async([img] * 32, threads=1, cancel=token)
+        )
+        await asyncio.sleep(0)
+        task.cancel()
+        with pytest.raises(asyncio.CancelledError):
+            await task
+        assert token.cancelled
+
+    async def test_async_decode_with_budget(self):
+        import asyncio
+
+        ctx_sync = pylibheif.HeifContext()
+        pylibheif.HeifEncoder(pylibheif.HeifCompressionFormat.HEVC).encode_image(
+            ctx_sync, create_dummy_image()
+        )
+        ctx = pylibheif.AsyncHeifContext()
+        await ctx.read_from_memory(ctx_sync.write_to_bytes())
+        handle = ctx.get_primary_image_handle()
+
+        # A budget of one byte admits a single decode at a time
+        budget = pylibheif.MemoryBudget(1)
+        images = await asyncio.gather(*(handle.decode(budget=budget) for _ in range(4)))
+        assert len(images) == 4
+        assert budget.admitted == 4
+        assert budget.in_use == 0
+        assert budget.peak == handle._handle.estimate_decode_bytes()
+
+    async def test_work_queue_submit(self):
+        import asyncio
+
+        loop = asyncio.get_running_loop()
+        with pylibheif.WorkQueue(threads=2) as queue:
+            assert queue.threads == 2
+            results = await asyncio.gather(
+                *(queue.submit(loop, lambda x, y=0: x + y, i, y=1) for i in range(50))
+            )
+            assert results == [i + 1 for i in range(50)]
+
+            def fail():
+                raise ValueError("boom")
+
+            with pytest.raises(ValueError, match="boom"):
+                await queue.submit(loop, fail)
+
+        assert queue.is_shutdown
+        with pytest.raises(RuntimeError):
+            queue.submit(loop, print)
+
+    @pytest.mark.filterwarnings("ignore::pytest.PytestUnraisableExceptionWarning")
+    async def test_work_queue_survives_broken_future(self):
+        import asyncio
+        import sys
+
+        class BrokenFuture:
+            def cancelled(self):
+                raise RuntimeError("broken future")
+
+        class FakeLoop:
+            def create_future(self):
+                return BrokenFuture()
+
+        reported = []
+        old_hook = sys.unraisablehook
+        sys.unraisablehook = lambda info: reported.append(info.exc_value)
+        try:
+            loop = asyncio.get_running_loop()
+            with pylibheif.WorkQueue(threads=1) as queue:
+                queue.submit(FakeLoop(), print)
+                # The same worker must still be alive to run the next job
+                assert await queue.submit(loop, lambda: 42) == 42
+        finally:
+            sys.unraisablehook = old_hook
+        assert any(isinstance(e, RuntimeError) for e in reported)
+
+    async def test_async_uses_work_queue(self):
+        import asyncio
+
+        queue = pylibheif.WorkQueue(threads=1)
+        pylibheif.set_work_queue(queue)
+        try:
+            assert pylibheif.get_work_queue() is queue
+            ctx = pylibheif.AsyncHeifContext()
+            encoder = pylibheif.AsyncHeifEncoder(pylibheif.HeifCompressionFormat.HEVC)
+            await encoder.encode_image(ctx, create_dummy_image())
+            data = await ctx.write_to_bytes()
+
+            # Several decodes in flight on one worker
+            contexts = [pylibheif.AsyncHeifContext() for _ in range(4)]
+            await asyncio.gather(*(c.read_from_memory(data) for c in contexts))
+            images = await asyncio.gather(
+                *(c.get_primary_image_handle().decode() for c in contexts)
+            )
+            assert all(img.get_width(pylibheif.HeifChannel.Interleaved) == 64 for img in images)
+        finally:
+            pylibheif.set_work_queue(None)
+            queue.shutdown()
+        assert pylibheif.get_work_queue() is not queue